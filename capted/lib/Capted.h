@@ -1,8 +1,15 @@
 #pragma once
 
 #include "node/Node.h"
+#include "node/LabelDictionary.h"
+#include "node/TreeProfile.h"
+#include "node/TreeStore.h"
 #include "distance/AllPossibleMappings.h"
 #include "distance/Apted.h"
+#include "distance/DistanceCache.h"
+#include "distance/Dispatch.h"
+#include "distance/BatchedDistance.h"
+#include "distance/LowerBound.h"
 
 #include "CostModel.h"
 #include "InputParser.h"
@@ -8,12 +8,17 @@ namespace capted {
 // Cost Model
 //------------------------------------------------------------------------------
 
-template<class Data>
+// Cost is the type of every distance table in the algorithms. Models with
+// integral costs (e.g. unit costs) should use an integral type: the tables
+// shrink and the distances are exact.
+template<class Data, class Cost = float>
 class CostModel {
 public:
-    virtual float deleteCost(Node<Data>* n) const = 0;
-    virtual float insertCost(Node<Data>* n) const = 0;
-    virtual float renameCost(Node<Data>* n1, Node<Data>* n2) const = 0;
+    typedef Cost CostType;
+
+    virtual Cost deleteCost(Node<Data>* n) const = 0;
+    virtual Cost insertCost(Node<Data>* n) const = 0;
+    virtual Cost renameCost(Node<Data>* n1, Node<Data>* n2) const = 0;
 };
 
 } // namespace capted
@@ -24,6 +24,11 @@ public:
     std::string getLabel() const { return label; }
 };
 
+// Copies the data of a node for Node::clone.
+inline StringNodeData* cloneData(StringNodeData* data) {
+    return new StringNodeData(*data);
+}
+
 inline std::ostream &operator<<(std::ostream &os, StringNodeData const &stringNode) {
     os << stringNode.getLabel();
     return os;
@@ -118,19 +123,22 @@ public:
 // String Node Data Cost Model
 //------------------------------------------------------------------------------
 
-class StringCostModel : public CostModel<StringNodeData> {
+template<class Cost>
+class BasicStringCostModel : public CostModel<StringNodeData, Cost> {
 public:
-    virtual float deleteCost(Node<StringNodeData>* n) const override {
-        return 1.0f;
+    virtual Cost deleteCost(Node<StringNodeData>* n) const override {
+        return 1;
     }
 
-    virtual float insertCost(Node<StringNodeData>* n) const override {
-        return 1.0f;
+    virtual Cost insertCost(Node<StringNodeData>* n) const override {
+        return 1;
     }
 
-    virtual float renameCost(Node<StringNodeData>* n1, Node<StringNodeData>* n2) const override {
-        return (n1->getData()->getLabel() == n2->getData()->getLabel()) ? 0.0f : 1.0f;
+    virtual Cost renameCost(Node<StringNodeData>* n1, Node<StringNodeData>* n2) const override {
+        return (n1->getData()->getLabel() == n2->getData()->getLabel()) ? 0 : 1;
     }
 };
 
+typedef BasicStringCostModel<float> StringCostModel;
+
 } // namespace capted
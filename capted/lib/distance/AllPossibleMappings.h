@@ -25,8 +25,8 @@ static inline bool removeMappingElement(std::vector<IntPair> &mapping, IntPair p
 // Distance Algorithm (simple - exponential cost)
 //------------------------------------------------------------------------------
 
-template<class Data>
-class AllPossibleMappings : public TreeEditDistance<Data> {
+template<class Data, class Cost = float, class Index = Integer>
+class AllPossibleMappings : public TreeEditDistance<Data, Cost, Index> {
 private:
     std::vector<std::vector<IntPair>> generateAllOneToOneMappings() {
         // Start with an empty mapping - all nodes are deleted or inserted.
@@ -126,13 +126,13 @@ private:
         );
     }
 
-    float getMinCost(std::vector<std::vector<IntPair>> mappings) {
+    Cost getMinCost(std::vector<std::vector<IntPair>> mappings) {
         // Initialize min_cost to the upper bound.
-        float min_cost = this->size1 + this->size2;
+        Cost min_cost = this->size1 + this->size2;
 
         // Verify cost of each mapping.
         for (std::vector<IntPair> m : mappings) {
-            float m_cost = 0;
+            Cost m_cost = 0;
             // Sum up edit costs for all elements in the mapping m.
             for (IntPair e : m) {
                 // Add edit operation cost.
@@ -158,11 +158,11 @@ private:
     }
 
 public:
-    AllPossibleMappings(CostModel<Data>* costModel) : TreeEditDistance<Data>(costModel) {
+    AllPossibleMappings(CostModel<Data, Cost>* costModel) : TreeEditDistance<Data, Cost, Index>(costModel) {
         // nop
     }
 
-    virtual float computeEditDistance(Node<Data>* t1, Node<Data>* t2) override {
+    virtual Cost computeEditDistance(Node<Data>* t1, Node<Data>* t2) override {
         this->init(t1, t2);
         std::vector<std::vector<IntPair>> mappings = generateAllOneToOneMappings();
         removeNonTEDMappings(mappings);
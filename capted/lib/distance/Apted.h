@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cmath>
+#include <limits>
 #include <vector>
 #include <stack>
 #include "TreeEditDistance.h"
+#include "SmallTree.h"
+#include "DistanceCache.h"
 #include "util/debug.h"
 #include "util/int.h"
 
@@ -35,21 +38,36 @@ static inline T signum(T val) {
 // Distance Algorithm (apted)
 //------------------------------------------------------------------------------
 
-template<class Data>
-class Apted : public TreeEditDistance<Data> {
+template<class Data, class Cost = float, class Index = Integer>
+class Apted : public TreeEditDistance<Data, Cost, Index> {
 private:
-    static const Integer LEFT = 0;
-    static const Integer RIGHT = 1;
-    static const Integer INNER = 2;
+    typedef typename NodeIndexer<Data, Cost, Index>::Sum Sum;
 
-    std::vector<std::vector<float>> delta;
+    static const Index LEFT = 0;
+    static const Index RIGHT = 1;
+    static const Index INNER = 2;
 
-    std::vector<float> q;
-    std::vector<Integer> fn;
-    std::vector<Integer> ft;
+    bool routeSmallTrees = true;
+
+    // Distances of earlier pairs of trees, shared with other instances, and
+    // the id of the cost model of this instance in it.
+    DistanceCache* distanceCache = nullptr;
+    uint32_t costModelId = 0;
+
+    // The input trees of the last distance computation, and whether delta
+    // holds the subtree distances of that pair.
+    Node<Data>* input1 = nullptr;
+    Node<Data>* input2 = nullptr;
+    bool deltaComputed = false;
+
+    std::vector<std::vector<Cost>> delta;
+
+    std::vector<Cost> q;
+    std::vector<Index> fn;
+    std::vector<Index> ft;
     long counter = 0;
 
-    void updateFnArray(Integer lnForNode, Integer node, Integer currentSubtreePreL) {
+    void updateFnArray(Index lnForNode, Index node, Index currentSubtreePreL) {
         if (lnForNode >= currentSubtreePreL) {
             fn[node] = fn[lnForNode];
             fn[lnForNode] = node;
@@ -59,18 +77,18 @@ private:
         }
     }
 
-    void updateFtArray(Integer lnForNode, Integer node) {
+    void updateFtArray(Index lnForNode, Index node) {
         ft[node] = lnForNode;
         if(fn[node] > -1) {
             ft[fn[node]] = node;
         }
     }
 
-    Integer getStrategyPathType(Integer pathIDWithPathIDOffset, Integer pathIDOffset, NodeIndexer<Data>* it, Integer currentRootNodePreL, Integer currentSubtreeSize) {
+    Index getStrategyPathType(Index pathIDWithPathIDOffset, Index pathIDOffset, NodeIndexer<Data, Cost, Index>* it, Index currentRootNodePreL, Index currentSubtreeSize) {
         if (signum(pathIDWithPathIDOffset) == -1) {
             return LEFT;
         }
-        Integer pathID = std::abs(pathIDWithPathIDOffset) - 1;
+        Index pathID = std::abs(pathIDWithPathIDOffset) - 1;
         if (pathID >= pathIDOffset) {
             pathID = pathID - pathIDOffset;
         }
@@ -82,73 +100,73 @@ private:
 
     //--------------------------------------------------------------------------
 
-    float spfA(NodeIndexer<Data>* it1, NodeIndexer<Data>* it2, Integer pathID, Integer pathType, bool treesSwapped) {
-        std::vector<Node<Data>*> &it2nodes = it2->preL_to_node;
+    Cost spfA(NodeIndexer<Data, Cost, Index>* it1, NodeIndexer<Data, Cost, Index>* it2, Index pathID, Index pathType, bool treesSwapped) {
+        Node<Data>** it2nodes = it2->preL_to_node;
         Node<Data>* lFNode;
-        std::vector<Integer> &it1sizes = it1->sizes;
-        std::vector<Integer> &it2sizes = it2->sizes;
-        std::vector<Integer> &it1parents = it1->parents;
-        std::vector<Integer> &it2parents = it2->parents;
-        std::vector<Integer> &it1preL_to_preR = it1->preL_to_preR;
-        std::vector<Integer> &it2preL_to_preR = it2->preL_to_preR;
-        std::vector<Integer> &it1preR_to_preL = it1->preR_to_preL;
-        std::vector<Integer> &it2preR_to_preL = it2->preR_to_preL;
-        Integer currentSubtreePreL1 = it1->getCurrentNode();
-        Integer currentSubtreePreL2 = it2->getCurrentNode();
+        Index* it1sizes = it1->sizes;
+        Index* it2sizes = it2->sizes;
+        Index* it1parents = it1->parents;
+        Index* it2parents = it2->parents;
+        Index* it1preL_to_preR = it1->preL_to_preR;
+        Index* it2preL_to_preR = it2->preL_to_preR;
+        Index* it1preR_to_preL = it1->preR_to_preL;
+        Index* it2preR_to_preL = it2->preR_to_preL;
+        Index currentSubtreePreL1 = it1->getCurrentNode();
+        Index currentSubtreePreL2 = it2->getCurrentNode();
 
         // Variables to incrementally sum up the forest sizes.
-        Integer currentForestSize1 = 0;
-        Integer currentForestSize2 = 0;
-        Integer tmpForestSize1 = 0;
+        Index currentForestSize1 = 0;
+        Index currentForestSize2 = 0;
+        Index tmpForestSize1 = 0;
 
         // Variables to incrementally sum up the forest cost.
-        float currentForestCost1 = 0;
-        float currentForestCost2 = 0;
-        float tmpForestCost1 = 0;
+        Cost currentForestCost1 = 0;
+        Cost currentForestCost2 = 0;
+        Cost tmpForestCost1 = 0;
 
-        Integer subtreeSize2 = it2->sizes[currentSubtreePreL2];
-        Integer subtreeSize1 = it1->sizes[currentSubtreePreL1];
-        std::vector<std::vector<float>> t(subtreeSize2 + 1);
+        Index subtreeSize2 = it2->sizes[currentSubtreePreL2];
+        Index subtreeSize1 = it1->sizes[currentSubtreePreL1];
+        std::vector<std::vector<Cost>> t(subtreeSize2 + 1);
         for (size_t i = 0; i < t.size(); i++) {
             t[i].resize(subtreeSize2 + 1);
         }
-        std::vector<std::vector<float>> s(subtreeSize1 + 1);
+        std::vector<std::vector<Cost>> s(subtreeSize1 + 1);
         for (size_t i = 0; i < s.size(); i++) {
             s[i].resize(subtreeSize2 + 1);
         }
 
-        float minCost = -1;
+        Cost minCost = -1;
 
         // sp1, sp2 and sp3 correspond to three elements of the minimum in the
         // recursive formula [1, Figure 12].
-        float sp1 = 0;
-        float sp2 = 0;
-        float sp3 = 0;
-        Integer startPathNode = -1;
-        Integer endPathNode = pathID;
-        Integer it1PreLoff = endPathNode;
-        Integer it2PreLoff = currentSubtreePreL2;
-        Integer it1PreRoff = it1preL_to_preR[endPathNode];
-        Integer it2PreRoff = it2preL_to_preR[it2PreLoff];
+        Cost sp1 = 0;
+        Cost sp2 = 0;
+        Cost sp3 = 0;
+        Index startPathNode = -1;
+        Index endPathNode = pathID;
+        Index it1PreLoff = endPathNode;
+        Index it2PreLoff = currentSubtreePreL2;
+        Index it1PreRoff = it1preL_to_preR[endPathNode];
+        Index it2PreRoff = it2preL_to_preR[it2PreLoff];
         // variable declarations which were inside the loops
-        Integer rFlast,lFlast,endPathNode_in_preR,startPathNode_in_preR,parent_of_endPathNode,parent_of_endPathNode_in_preR,
+        Index rFlast,lFlast,endPathNode_in_preR,startPathNode_in_preR,parent_of_endPathNode,parent_of_endPathNode_in_preR,
         lFfirst,rFfirst,rGlast,rGfirst,lGfirst,rG_in_preL,rGminus1_in_preL,parent_of_rG_in_preL,lGlast,lF_in_preR,lFSubtreeSize,
         lGminus1_in_preR,parent_of_lG,parent_of_lG_in_preR,rF_in_preL,rFSubtreeSize,
         rGfirst_in_preL;
 
         bool leftPart,rightPart,fForestIsTree,lFIsConsecutiveNodeOfCurrentPathNode,lFIsLeftSiblingOfCurrentPathNode,
         rFIsConsecutiveNodeOfCurrentPathNode,rFIsRightSiblingOfCurrentPathNode;
-        std::vector<float>* sp1spointer;
-        std::vector<float>* sp2spointer;
-        std::vector<float>* sp3spointer;
-        std::vector<float>* sp3deltapointer;
-        std::vector<float>* swritepointer;
-        std::vector<float>* sp1tpointer;
-        std::vector<float>* sp3tpointer;
+        std::vector<Cost>* sp1spointer;
+        std::vector<Cost>* sp2spointer;
+        std::vector<Cost>* sp3spointer;
+        std::vector<Cost>* sp3deltapointer;
+        std::vector<Cost>* swritepointer;
+        std::vector<Cost>* sp1tpointer;
+        std::vector<Cost>* sp3tpointer;
 
         // These variables store the id of the source (which array) of looking up
         // elements of the minimum in the recursive formula [1, Figures 12,13].
-        Integer sp1source,sp3source;
+        Index sp1source,sp3source;
 
         // Loop A [1, Algorithm 3] - walk up the path.
         while (endPathNode >= currentSubtreePreL1) {
@@ -157,9 +175,9 @@ private:
             rFlast = -1;
             lFlast = -1;
             endPathNode_in_preR = it1preL_to_preR[endPathNode];
-            startPathNode_in_preR = startPathNode == -1 ? 0x7fffffff : it1preL_to_preR[startPathNode];
+            startPathNode_in_preR = startPathNode == -1 ? std::numeric_limits<Index>::max() : it1preL_to_preR[startPathNode];
             parent_of_endPathNode = it1parents[endPathNode];
-            parent_of_endPathNode_in_preR = parent_of_endPathNode == -1 ? 0x7fffffff : it1preL_to_preR[parent_of_endPathNode];
+            parent_of_endPathNode_in_preR = parent_of_endPathNode == -1 ? std::numeric_limits<Index>::max() : it1preL_to_preR[parent_of_endPathNode];
 
             if (startPathNode - endPathNode > 1) {
                 leftPart = true;
@@ -192,7 +210,7 @@ private:
                 lFlast = rightPart ? endPathNode + 1 : endPathNode;
                 fn[fn.size() - 1] = -1;
 
-                for (Integer i = currentSubtreePreL2; i < currentSubtreePreL2 + subtreeSize2; i++) {
+                for (Index i = currentSubtreePreL2; i < currentSubtreePreL2 + subtreeSize2; i++) {
                     fn[i] = -1;
                     ft[i] = -1;
                 }
@@ -202,10 +220,10 @@ private:
                 tmpForestCost1 = currentForestCost1;
 
                 // Loop B [1, Algoritm 3] - for all nodes in G (right-hand input tree).
-                for (Integer rG = rGfirst; rG >= rGlast; rG--) {
+                for (Index rG = rGfirst; rG >= rGlast; rG--) {
                     lGfirst = it2preR_to_preL[rG];
                     rG_in_preL = it2preR_to_preL[rG];
-                    rGminus1_in_preL = rG <= it2preL_to_preR[currentSubtreePreL2] ? 0x7fffffff : it2preR_to_preL[rG - 1];
+                    rGminus1_in_preL = rG <= it2preL_to_preR[currentSubtreePreL2] ? std::numeric_limits<Index>::max() : it2preR_to_preL[rG - 1];
                     parent_of_rG_in_preL = it2parents[rG_in_preL];
                     // This if statement decides on the last lG node for Loop D [1, Algorithm 3];
                     if (pathType == 1) {
@@ -220,14 +238,14 @@ private:
 
                     updateFnArray(it2->preL_to_ln[lGfirst], lGfirst, currentSubtreePreL2);
                     updateFtArray(it2->preL_to_ln[lGfirst], lGfirst);
-                    Integer rF = rFfirst;
+                    Index rF = rFfirst;
 
                     // Reset size and cost of the forest in F.
                     currentForestSize1 = tmpForestSize1;
                     currentForestCost1 = tmpForestCost1;
 
                     // Loop C [1, Algorithm 3] - for all nodes to the left of the path node.
-                    for (Integer lF = lFfirst; lF >= lFlast; lF--) {
+                    for (Index lF = lFfirst; lF >= lFlast; lF--) {
                         // This if statement fixes rF node.
                         if (lF == lFlast && !rightPart) {
                             rF = rFlast;
@@ -278,7 +296,7 @@ private:
                         }
 
                         // Go to first lG.
-                        Integer lG = lGfirst;
+                        Index lG = lGfirst;
 
                         // currentForestSize2++;
                         // sp1, sp2, sp3 -- Done here for the first node in Loop D. It differs for consecutive nodes.
@@ -378,13 +396,13 @@ private:
                             }
                         }
 
-                        for (Integer lF = lFfirst; lF >= lFlast; lF--) {
+                        for (Index lF = lFfirst; lF >= lFlast; lF--) {
                             q[lF] = s[lF - it1PreLoff][(parent_of_rG_in_preL + 1) - it2PreLoff];
                         }
                     }
 
                     // TODO: first pointers can be precomputed
-                    for (Integer lG = lGfirst; lG >= lGlast; lG = ft[lG]) {
+                    for (Index lG = lGfirst; lG >= lGlast; lG = ft[lG]) {
                         t[lG - it2PreLoff][rG - it2PreRoff] = s[lFlast - it1PreLoff][lG - it2PreLoff];
                     }
                 }
@@ -406,7 +424,7 @@ private:
                 rFlast = it1preL_to_preR[endPathNode];
                 fn[fn.size() - 1] = -1;
 
-                for (Integer i = currentSubtreePreL2; i < currentSubtreePreL2 + subtreeSize2; i++){
+                for (Index i = currentSubtreePreL2; i < currentSubtreePreL2 + subtreeSize2; i++){
                     fn[i] = -1;
                     ft[i] = -1;
                 }
@@ -416,12 +434,12 @@ private:
                 tmpForestCost1 = currentForestCost1;
 
                 // Loop B' [1, Algorithm 3] - for all nodes in G.
-                for (Integer lG = lGfirst; lG >= lGlast; lG--) {
+                for (Index lG = lGfirst; lG >= lGlast; lG--) {
                     rGfirst = it2preL_to_preR[lG];
                     updateFnArray(it2->preR_to_ln[rGfirst], rGfirst, it2preL_to_preR[currentSubtreePreL2]);
                     updateFtArray(it2->preR_to_ln[rGfirst], rGfirst);
-                    Integer lF = lFfirst;
-                    lGminus1_in_preR = lG <= currentSubtreePreL2 ? 0x7fffffff : it2preL_to_preR[lG - 1];
+                    Index lF = lFfirst;
+                    lGminus1_in_preR = lG <= currentSubtreePreL2 ? std::numeric_limits<Index>::max() : it2preL_to_preR[lG - 1];
                     parent_of_lG = it2parents[lG];
                     parent_of_lG_in_preR = parent_of_lG == -1 ? -1 : it2preL_to_preR[parent_of_lG];
 
@@ -432,7 +450,7 @@ private:
                     if (pathType == 0) {
                         if (lG == currentSubtreePreL2) {
                             rGlast = rGfirst;
-                        } else if (it2->children[parent_of_lG][0] != lG) {
+                        } else if (*it2->childrenBegin(parent_of_lG) != lG) {
                             rGlast = rGfirst;
                         } else {
                             rGlast = it2preL_to_preR[parent_of_lG]+1;
@@ -442,7 +460,7 @@ private:
                     }
 
                     // Loop C' [1, Algorithm 3] - for all nodes to the right of the path node.
-                    for (Integer rF = rFfirst; rF >= rFlast; rF--) {
+                    for (Index rF = rFfirst; rF >= rFlast; rF--) {
                         if (rF == rFlast) {
                             lF = lFlast;
                         }
@@ -505,7 +523,7 @@ private:
                             sp2 = q[rF];
                         }
 
-                        Integer rG = rGfirst;
+                        Index rG = rGfirst;
                         rGfirst_in_preL = it2preR_to_preL[rGfirst];
                         currentForestSize2++;
 
@@ -590,13 +608,13 @@ private:
                             }
                         }
 
-                        for (Integer rF = rFfirst; rF >= rFlast; rF--) {
+                        for (Index rF = rFfirst; rF >= rFlast; rF--) {
                             q[rF] = s[rF - it1PreRoff][(parent_of_lG_in_preR + 1) - it2PreRoff];
                         }
                     }
 
                     // TODO: first pointers can be precomputed
-                    for (Integer rG = rGfirst; rG >= rGlast; rG = ft[rG]) {
+                    for (Index rG = rGfirst; rG >= rGlast; rG = ft[rG]) {
                         t[lG - it2PreLoff][rG - it2PreRoff] = s[rFlast - it1PreRoff][rG - it2PreRoff];
                     }
                 }
@@ -612,21 +630,21 @@ private:
 
     //--------------------------------------------------------------------------
 
-    float spfL(NodeIndexer<Data>* it1, NodeIndexer<Data>* it2, bool treesSwapped) {
+    Cost spfL(NodeIndexer<Data, Cost, Index>* it1, NodeIndexer<Data, Cost, Index>* it2, bool treesSwapped) {
         // Initialise the array to store the keyroot nodes in the right-hand input subtree.
-        std::vector<Integer> keyRoots(it2->sizes[it2->getCurrentNode()], -1);
+        std::vector<Index> keyRoots(it2->sizes[it2->getCurrentNode()], -1);
 
         // Get the leftmost leaf node of the right-hand input subtree.
-        Integer pathID = it2->preL_to_lld(it2->getCurrentNode());
+        Index pathID = it2->preL_to_lld(it2->getCurrentNode());
 
         // Calculate the keyroot nodes in the right-hand input subtree.
         // firstKeyRoot is the index in keyRoots of the first keyroot node that
         // we have to process. We need this index because keyRoots array is larger
         // than the number of keyroot nodes.
-        Integer firstKeyRoot = computeKeyRoots(it2, it2->getCurrentNode(), pathID, keyRoots, 0);
+        Index firstKeyRoot = computeKeyRoots(it2, it2->getCurrentNode(), pathID, keyRoots, 0);
 
         // Initialise an array to store intermediate distances for subforest pairs.
-        std::vector<std::vector<float>> forestdist(it1->sizes[it1->getCurrentNode()] + 1);
+        std::vector<std::vector<Cost>> forestdist(it1->sizes[it1->getCurrentNode()] + 1);
         for (size_t i = 0; i < forestdist.size(); i++) {
             forestdist[i].resize(it2->sizes[it2->getCurrentNode()] + 1);
         }
@@ -635,14 +653,14 @@ private:
         // input subtree only the root is the keyroot. Thus, we compute the distance
         // between the left-hand input subtree and all keyroot nodes in the
         // right-hand input subtree.
-        for (Integer i = firstKeyRoot-1; i >= 0; i--) {
+        for (Index i = firstKeyRoot-1; i >= 0; i--) {
             treeEditDist(it1, it2, it1->getCurrentNode(), keyRoots[i], forestdist, treesSwapped);
         }
 
         return forestdist[it1->sizes[it1->getCurrentNode()]][it2->sizes[it2->getCurrentNode()]];
     }
 
-    Integer computeKeyRoots(NodeIndexer<Data>* it2, Integer subtreeRootNode, Integer pathID, std::vector<Integer> &keyRoots, Integer index) {
+    Index computeKeyRoots(NodeIndexer<Data, Cost, Index>* it2, Index subtreeRootNode, Index pathID, std::vector<Index> &keyRoots, Index index) {
         // The subtreeRootNode is a keyroot node. Add it to keyRoots.
         keyRoots[index] = subtreeRootNode;
 
@@ -651,13 +669,14 @@ private:
 
         // Walk up the left path starting with the leftmost leaf of subtreeRootNode,
         // until the child of subtreeRootNode.
-        Integer pathNode = pathID;
+        Index pathNode = pathID;
 
         while (pathNode > subtreeRootNode) {
-            Integer parent = it2->parents[pathNode];
+            Index parent = it2->parents[pathNode];
             // For each sibling to the right of pathNode, execute this method recursively.
             // Each right sibling of pathNode is a keyroot node.
-            for (Integer child : it2->children[parent]) {
+            for (const Index* c = it2->childrenBegin(parent); c != it2->childrenEnd(parent); c++) {
+                Index child = *c;
                 // Execute computeKeyRoots recursively for the new subtree rooted at child and child's leftmost leaf node.
                 if (child != pathNode) {
                     index = computeKeyRoots(it2, child, it2->preL_to_lld(child), keyRoots, index);
@@ -670,42 +689,42 @@ private:
         return index;
     }
 
-    void treeEditDist(NodeIndexer<Data>* it1, NodeIndexer<Data>* it2, Integer it1subtree, Integer it2subtree, std::vector<std::vector<float>> &forestdist, bool treesSwapped) {
+    void treeEditDist(NodeIndexer<Data, Cost, Index>* it1, NodeIndexer<Data, Cost, Index>* it2, Index it1subtree, Index it2subtree, std::vector<std::vector<Cost>> &forestdist, bool treesSwapped) {
         // Translate input subtree root nodes to left-to-right postorder.
-        Integer i = it1->preL_to_postL[it1subtree];
-        Integer j = it2->preL_to_postL[it2subtree];
+        Index i = it1->preL_to_postL[it1subtree];
+        Index j = it2->preL_to_postL[it2subtree];
 
         // We need to offset the node ids for accessing forestdist array which has
         // indices from 0 to subtree size. However, the subtree node indices do not
         // necessarily start with 0.
         // Whenever the original left-to-right postorder id has to be accessed, use
         // i+ioff and j+joff.
-        Integer ioff = it1->postL_to_lld[i] - 1;
-        Integer joff = it2->postL_to_lld[j] - 1;
+        Index ioff = it1->postL_to_lld[i] - 1;
+        Index joff = it2->postL_to_lld[j] - 1;
 
         // Variables holding costs of each minimum element.
-        float da = 0;
-        float db = 0;
-        float dc = 0;
+        Cost da = 0;
+        Cost db = 0;
+        Cost dc = 0;
 
         // Initialize forestdist array with deletion and insertion costs of each
         // relevant subforest.
         forestdist[0][0] = 0;
-        for (Integer i1 = 1; i1 <= i - ioff; i1++) {
+        for (Index i1 = 1; i1 <= i - ioff; i1++) {
             forestdist[i1][0] = forestdist[i1 - 1][0] + (treesSwapped ? this->costModel->insertCost(it1->postL_to_node(i1 + ioff)) : this->costModel->deleteCost(it1->postL_to_node(i1 + ioff))); // USE COST MODEL - delete i1.
         }
-        for (Integer j1 = 1; j1 <= j - joff; j1++) {
+        for (Index j1 = 1; j1 <= j - joff; j1++) {
             forestdist[0][j1] = forestdist[0][j1 - 1] + (treesSwapped ? this->costModel->deleteCost(it2->postL_to_node(j1 + joff)) : this->costModel->insertCost(it2->postL_to_node(j1 + joff))); // USE COST MODEL - insert j1.
         }
 
         // Fill in the remaining costs.
-        for (Integer i1 = 1; i1 <= i - ioff; i1++) {
-            for (Integer j1 = 1; j1 <= j - joff; j1++) {
+        for (Index i1 = 1; i1 <= i - ioff; i1++) {
+            for (Index j1 = 1; j1 <= j - joff; j1++) {
                 // Increment the number of subproblems.
                 counter++;
 
                 // Calculate partial distance values for this subproblem.
-                float u = (treesSwapped ? this->costModel->renameCost(it2->postL_to_node(j1 + joff), it1->postL_to_node(i1 + ioff)) : this->costModel->renameCost(it1->postL_to_node(i1 + ioff), it2->postL_to_node(j1 + joff))); // USE COST MODEL - rename i1 to j1.
+                Cost u = (treesSwapped ? this->costModel->renameCost(it2->postL_to_node(j1 + joff), it1->postL_to_node(i1 + ioff)) : this->costModel->renameCost(it1->postL_to_node(i1 + ioff), it2->postL_to_node(j1 + joff))); // USE COST MODEL - rename i1 to j1.
                 da = forestdist[i1 - 1][j1] + (treesSwapped ? this->costModel->insertCost(it1->postL_to_node(i1 + ioff)) : this->costModel->deleteCost(it1->postL_to_node(i1 + ioff))); // USE COST MODEL - delete i1.
                 db = forestdist[i1][j1 - 1] + (treesSwapped ? this->costModel->deleteCost(it2->postL_to_node(j1 + joff)) : this->costModel->insertCost(it2->postL_to_node(j1 + joff))); // USE COST MODEL - insert j1.
 
@@ -732,21 +751,21 @@ private:
 
     //--------------------------------------------------------------------------
 
-    float spfR(NodeIndexer<Data>* it1, NodeIndexer<Data>* it2, bool treesSwapped) {
+    Cost spfR(NodeIndexer<Data, Cost, Index>* it1, NodeIndexer<Data, Cost, Index>* it2, bool treesSwapped) {
         // Initialise the array to store the keyroot nodes in the right-hand input subtree.
-        std::vector<Integer> revKeyRoots(it2->sizes[it2->getCurrentNode()], -1);
+        std::vector<Index> revKeyRoots(it2->sizes[it2->getCurrentNode()], -1);
 
         // Get the rightmost leaf node of the right-hand input subtree.
-        Integer pathID = it2->preL_to_rld(it2->getCurrentNode());
+        Index pathID = it2->preL_to_rld(it2->getCurrentNode());
 
         // Calculate the keyroot nodes in the right-hand input subtree.
         // firstKeyRoot is the index in keyRoots of the first keyroot node that
         // we have to process. We need this index because keyRoots array is larger
         // than the number of keyroot nodes.
-        Integer firstKeyRoot = computeRevKeyRoots(it2, it2->getCurrentNode(), pathID, revKeyRoots, 0);
+        Index firstKeyRoot = computeRevKeyRoots(it2, it2->getCurrentNode(), pathID, revKeyRoots, 0);
 
         // Initialise an array to store intermediate distances for subforest pairs.
-        std::vector<std::vector<float>> forestdist(it1->sizes[it1->getCurrentNode()] + 1);
+        std::vector<std::vector<Cost>> forestdist(it1->sizes[it1->getCurrentNode()] + 1);
         for (size_t i = 0; i < forestdist.size(); i++) {
             forestdist[i].resize(it2->sizes[it2->getCurrentNode()] + 1);
         }
@@ -755,7 +774,7 @@ private:
         // input subtree only the root is the keyroot. Thus, we compute the distance
         // between the left-hand input subtree and all keyroot nodes in the
         // right-hand input subtree.
-        for (Integer i = firstKeyRoot - 1; i >= 0; i--) {
+        for (Index i = firstKeyRoot - 1; i >= 0; i--) {
             revTreeEditDist(it1, it2, it1->getCurrentNode(), revKeyRoots[i], forestdist, treesSwapped);
         }
 
@@ -763,7 +782,7 @@ private:
         return forestdist[it1->sizes[it1->getCurrentNode()]][it2->sizes[it2->getCurrentNode()]];
     }
 
-    Integer computeRevKeyRoots(NodeIndexer<Data>* it2, Integer subtreeRootNode, Integer pathID, std::vector<Integer> &revKeyRoots, Integer index) {
+    Index computeRevKeyRoots(NodeIndexer<Data, Cost, Index>* it2, Index subtreeRootNode, Index pathID, std::vector<Index> &revKeyRoots, Index index) {
         // The subtreeRootNode is a keyroot node. Add it to keyRoots.
         revKeyRoots[index] = subtreeRootNode;
 
@@ -772,13 +791,14 @@ private:
 
         // Walk up the right path starting with the rightmost leaf of
         // subtreeRootNode, until the child of subtreeRootNode.
-        Integer pathNode = pathID;
+        Index pathNode = pathID;
 
         while (pathNode > subtreeRootNode) {
-            Integer parent = it2->parents[pathNode];
+            Index parent = it2->parents[pathNode];
             // For each sibling to the left of pathNode, execute this method recursively.
             // Each left sibling of pathNode is a keyroot node.
-            for (Integer child : it2->children[parent]) {
+            for (const Index* c = it2->childrenBegin(parent); c != it2->childrenEnd(parent); c++) {
+                Index child = *c;
                 // Execute computeRevKeyRoots recursively for the new subtree rooted at child and child's rightmost leaf node.
                 if (child != pathNode) {
                     index = computeRevKeyRoots(it2, child, it2->preL_to_rld(child), revKeyRoots, index);
@@ -791,42 +811,42 @@ private:
         return index;
     }
 
-    void revTreeEditDist(NodeIndexer<Data>* it1, NodeIndexer<Data>* it2, Integer it1subtree, Integer it2subtree, std::vector<std::vector<float>> &forestdist, bool treesSwapped) {
+    void revTreeEditDist(NodeIndexer<Data, Cost, Index>* it1, NodeIndexer<Data, Cost, Index>* it2, Index it1subtree, Index it2subtree, std::vector<std::vector<Cost>> &forestdist, bool treesSwapped) {
         // Translate input subtree root nodes to right-to-left postorder.
-        Integer i = it1->preL_to_postR[it1subtree];
-        Integer j = it2->preL_to_postR[it2subtree];
+        Index i = it1->preL_to_postR[it1subtree];
+        Index j = it2->preL_to_postR[it2subtree];
 
         // We need to offset the node ids for accessing forestdist array which has
         // indices from 0 to subtree size. However, the subtree node indices do not
         // necessarily start with 0.
         // Whenever the original right-to-left postorder id has to be accessed, use
         // i+ioff and j+joff.
-        Integer ioff = it1->postR_to_rld[i] - 1;
-        Integer joff = it2->postR_to_rld[j] - 1;
+        Index ioff = it1->postR_to_rld[i] - 1;
+        Index joff = it2->postR_to_rld[j] - 1;
 
         // Variables holding costs of each minimum element.
-        float da = 0;
-        float db = 0;
-        float dc = 0;
+        Cost da = 0;
+        Cost db = 0;
+        Cost dc = 0;
 
         // Initialize forestdist array with deletion and insertion costs of each
         // relevant subforest.
         forestdist[0][0] = 0;
-        for (Integer i1 = 1; i1 <= i - ioff; i1++) {
+        for (Index i1 = 1; i1 <= i - ioff; i1++) {
             forestdist[i1][0] = forestdist[i1 - 1][0] + (treesSwapped ? this->costModel->insertCost(it1->postR_to_node(i1 + ioff)) : this->costModel->deleteCost(it1->postR_to_node(i1 + ioff))); // USE COST MODEL - delete i1.
         }
-        for (Integer j1 = 1; j1 <= j - joff; j1++) {
+        for (Index j1 = 1; j1 <= j - joff; j1++) {
             forestdist[0][j1] = forestdist[0][j1 - 1] + (treesSwapped ? this->costModel->deleteCost(it2->postR_to_node(j1 + joff)) : this->costModel->insertCost(it2->postR_to_node(j1 + joff))); // USE COST MODEL - insert j1.
         }
 
         // Fill in the remaining costs.
-        for (Integer i1 = 1; i1 <= i - ioff; i1++) {
-            for (Integer j1 = 1; j1 <= j - joff; j1++) {
+        for (Index i1 = 1; i1 <= i - ioff; i1++) {
+            for (Index j1 = 1; j1 <= j - joff; j1++) {
                 // Increment the number of subproblems.
                 counter++;
 
                 // Calculate partial distance values for this subproblem.
-                float u = (treesSwapped ? this->costModel->renameCost(it2->postR_to_node(j1 + joff), it1->postR_to_node(i1 + ioff)) : this->costModel->renameCost(it1->postR_to_node(i1 + ioff), it2->postR_to_node(j1 + joff))); // USE COST MODEL - rename i1 to j1.
+                Cost u = (treesSwapped ? this->costModel->renameCost(it2->postR_to_node(j1 + joff), it1->postR_to_node(i1 + ioff)) : this->costModel->renameCost(it1->postR_to_node(i1 + ioff), it2->postR_to_node(j1 + joff))); // USE COST MODEL - rename i1 to j1.
                 da = forestdist[i1 - 1][j1] + (treesSwapped ? this->costModel->insertCost(it1->postR_to_node(i1 + ioff)) : this->costModel->deleteCost(it1->postR_to_node(i1 + ioff))); // USE COST MODEL - delete i1.
                 db = forestdist[i1][j1 - 1] + (treesSwapped ? this->costModel->deleteCost(it2->postR_to_node(j1 + joff)) : this->costModel->insertCost(it2->postR_to_node(j1 + joff))); // USE COST MODEL - insert j1.
                 
@@ -852,26 +872,26 @@ private:
 
     //--------------------------------------------------------------------------
 
-    float spf1 (NodeIndexer<Data>* ni1, Integer subtreeRootNode1, NodeIndexer<Data>* ni2, Integer subtreeRootNode2) {
-        Integer subtreeSize1 = ni1->sizes[subtreeRootNode1];
-        Integer subtreeSize2 = ni2->sizes[subtreeRootNode2];
+    Cost spf1 (NodeIndexer<Data, Cost, Index>* ni1, Index subtreeRootNode1, NodeIndexer<Data, Cost, Index>* ni2, Index subtreeRootNode2) {
+        Index subtreeSize1 = ni1->sizes[subtreeRootNode1];
+        Index subtreeSize2 = ni2->sizes[subtreeRootNode2];
 
         if (subtreeSize1 == 1 && subtreeSize2 == 1) {
             Node<Data>* n1 = ni1->preL_to_node[subtreeRootNode1];
             Node<Data>* n2 = ni2->preL_to_node[subtreeRootNode2];
-            float maxCost = this->costModel->deleteCost(n1) + this->costModel->insertCost(n2);
-            float renCost = this->costModel->renameCost(n1, n2);
+            Cost maxCost = this->costModel->deleteCost(n1) + this->costModel->insertCost(n2);
+            Cost renCost = this->costModel->renameCost(n1, n2);
             return renCost < maxCost ? renCost : maxCost;
         }
 
         if (subtreeSize1 == 1) {
             Node<Data>* n1 = ni1->preL_to_node[subtreeRootNode1];
             Node<Data>* n2 = nullptr;
-            float cost = ni2->preL_to_sumInsCost[subtreeRootNode2];
-            float maxCost = cost + this->costModel->deleteCost(n1);
-            float minRenMinusIns = cost;
-            float nodeRenMinusIns = 0;
-            for (Integer i = subtreeRootNode2; i < subtreeRootNode2 + subtreeSize2; i++) {
+            Cost cost = ni2->preL_to_sumInsCost[subtreeRootNode2];
+            Cost maxCost = cost + this->costModel->deleteCost(n1);
+            Cost minRenMinusIns = cost;
+            Cost nodeRenMinusIns = 0;
+            for (Index i = subtreeRootNode2; i < subtreeRootNode2 + subtreeSize2; i++) {
                 n2 = ni2->preL_to_node[i];
                 nodeRenMinusIns = this->costModel->renameCost(n1, n2) - this->costModel->insertCost(n2);
                 if (nodeRenMinusIns < minRenMinusIns) {
@@ -887,12 +907,12 @@ private:
             Node<Data>* n1 = nullptr;
             Node<Data>* n2 = ni2->preL_to_node[subtreeRootNode2];
 
-            float cost = ni1->preL_to_sumDelCost[subtreeRootNode1];
-            float maxCost = cost + this->costModel->insertCost(n2);
-            float minRenMinusDel = cost;
-            float nodeRenMinusDel = 0;
+            Cost cost = ni1->preL_to_sumDelCost[subtreeRootNode1];
+            Cost maxCost = cost + this->costModel->insertCost(n2);
+            Cost minRenMinusDel = cost;
+            Cost nodeRenMinusDel = 0;
 
-            for (Integer i = subtreeRootNode1; i < subtreeRootNode1 + subtreeSize1; i++) {
+            for (Index i = subtreeRootNode1; i < subtreeRootNode1 + subtreeSize1; i++) {
                 n1 = ni1->preL_to_node[i];
                 nodeRenMinusDel = this->costModel->renameCost(n1, n2) - this->costModel->deleteCost(n1);
 
@@ -911,8 +931,8 @@ private:
     //--------------------------------------------------------------------------
 
     void computeOptStrategy_postL() {
-        Integer size1 = this->it1->getSize();
-        Integer size2 = this->it2->getSize();
+        Index size1 = this->it1->getSize();
+        Index size2 = this->it2->getSize();
 
         assert(delta.size() == 0);
         delta.resize(size1);
@@ -926,43 +946,43 @@ private:
         std::vector<float> cost2_L(size2);
         std::vector<float> cost2_R(size2);
         std::vector<float> cost2_I(size2);
-        std::vector<Integer> cost2_path(size2);
+        std::vector<Index> cost2_path(size2);
         std::vector<float> leafRow(size2);
-        Integer pathIDOffset = size1;
+        Index pathIDOffset = size1;
         float minCost = 0x7fffffffffffffffL;
-        Integer strategyPath = -1;
-
-        std::vector<Integer> &pre2size1 = this->it1->sizes;
-        std::vector<Integer> &pre2size2 = this->it2->sizes;
-        std::vector<Integer> &pre2descSum1 = this->it1->preL_to_desc_sum;
-        std::vector<Integer> &pre2descSum2 = this->it2->preL_to_desc_sum;
-        std::vector<Integer> &pre2krSum1 = this->it1->preL_to_kr_sum;
-        std::vector<Integer> &pre2krSum2 = this->it2->preL_to_kr_sum;
-        std::vector<Integer> &pre2revkrSum1 = this->it1->preL_to_rev_kr_sum;
-        std::vector<Integer> &pre2revkrSum2 = this->it2->preL_to_rev_kr_sum;
-        std::vector<Integer> &preL_to_preR_1 = this->it1->preL_to_preR;
-        std::vector<Integer> &preL_to_preR_2 = this->it2->preL_to_preR;
-        std::vector<Integer> &preR_to_preL_1 = this->it1->preR_to_preL;
-        std::vector<Integer> &preR_to_preL_2 = this->it2->preR_to_preL;
-        std::vector<Integer> &pre2parent1 = this->it1->parents;
-        std::vector<Integer> &pre2parent2 = this->it2->parents;
-        std::vector<bool> &nodeType_L_1 = this->it1->nodeType_L;
-        std::vector<bool> &nodeType_L_2 = this->it2->nodeType_L;
-        std::vector<bool> &nodeType_R_1 = this->it1->nodeType_R;
-        std::vector<bool> &nodeType_R_2 = this->it2->nodeType_R;
-
-        std::vector<Integer> &preL_to_postL_1 = this->it1->preL_to_postL;
-        std::vector<Integer> &preL_to_postL_2 = this->it2->preL_to_postL;
-        std::vector<Integer> &postL_to_preL_1 = this->it1->postL_to_preL;
-        std::vector<Integer> &postL_to_preL_2 = this->it2->postL_to_preL;
-
-        Integer size_w,
+        Index strategyPath = -1;
+
+        Index* pre2size1 = this->it1->sizes;
+        Index* pre2size2 = this->it2->sizes;
+        Sum* pre2descSum1 = this->it1->preL_to_desc_sum;
+        Sum* pre2descSum2 = this->it2->preL_to_desc_sum;
+        Sum* pre2krSum1 = this->it1->preL_to_kr_sum;
+        Sum* pre2krSum2 = this->it2->preL_to_kr_sum;
+        Sum* pre2revkrSum1 = this->it1->preL_to_rev_kr_sum;
+        Sum* pre2revkrSum2 = this->it2->preL_to_rev_kr_sum;
+        Index* preL_to_preR_1 = this->it1->preL_to_preR;
+        Index* preL_to_preR_2 = this->it2->preL_to_preR;
+        Index* preR_to_preL_1 = this->it1->preR_to_preL;
+        Index* preR_to_preL_2 = this->it2->preR_to_preL;
+        Index* pre2parent1 = this->it1->parents;
+        Index* pre2parent2 = this->it2->parents;
+        uint8_t* nodeType_L_1 = this->it1->nodeType_L;
+        uint8_t* nodeType_L_2 = this->it2->nodeType_L;
+        uint8_t* nodeType_R_1 = this->it1->nodeType_R;
+        uint8_t* nodeType_R_2 = this->it2->nodeType_R;
+
+        Index* preL_to_postL_1 = this->it1->preL_to_postL;
+        Index* preL_to_postL_2 = this->it2->preL_to_postL;
+        Index* postL_to_preL_1 = this->it1->postL_to_preL;
+        Index* postL_to_preL_2 = this->it2->postL_to_preL;
+
+        Index size_w,
             size_v,
             parent_w_preL,
             parent_v_preL,
             parent_w_postL = -1,
             parent_v_postL = -1;
-        Integer leftPath_v,
+        Index leftPath_v,
             rightPath_v;
 
         std::vector<float> cost_Lpointer_v,
@@ -971,19 +991,19 @@ private:
         std::vector<float> cost_Lpointer_parent_v, 
                            cost_Rpointer_parent_v,
                            cost_Ipointer_parent_v;
-        std::vector<float> strategypointer_parent_v;
+        std::vector<Cost> strategypointer_parent_v;
 
-        Integer krSum_v, revkrSum_v, descSum_v;
+        Sum krSum_v, revkrSum_v, descSum_v;
         bool is_v_leaf;
 
-        Integer v_in_preL;
-        Integer w_in_preL;
+        Index v_in_preL;
+        Index w_in_preL;
 
         std::stack<std::vector<float>> rowsToReuse_L;
         std::stack<std::vector<float>> rowsToReuse_R;
         std::stack<std::vector<float>> rowsToReuse_I;
 
-        for(Integer v = 0; v < size1; v++) {
+        for(Index v = 0; v < size1; v++) {
             v_in_preL = postL_to_preL_1[v];
 
             is_v_leaf = this->it1->isLeaf(v_in_preL);
@@ -1004,7 +1024,7 @@ private:
                 cost1_L[v] = leafRow;
                 cost1_R[v] = leafRow;
                 cost1_I[v] = leafRow;
-                for(Integer i = 0; i < size2; i++) {
+                for(Index i = 0; i < size2; i++) {
                     delta[v_in_preL][postL_to_preL_2[i]] = v_in_preL;
                 }
             }
@@ -1040,9 +1060,9 @@ private:
             fillArray(cost2_L, 0.0f);
             fillArray(cost2_R, 0.0f);
             fillArray(cost2_I, 0.0f);
-            fillArray(cost2_path, (Integer)0);
+            fillArray(cost2_path, (Index)0);
 
-            for(Integer w = 0; w < size2; w++) {
+            for(Index w = 0; w < size2; w++) {
                 w_in_preL = postL_to_preL_2[w];
 
                 parent_w_preL = pre2parent2[w_in_preL];
@@ -1078,7 +1098,7 @@ private:
                     tmpCost = (float) size_v * (float) pre2descSum2[w_in_preL] + cost_Ipointer_v[w];
                     if (tmpCost < minCost) {
                         minCost = tmpCost;
-                        strategyPath = (Integer)delta[v_in_preL][w_in_preL] + 1;
+                        strategyPath = (Index)delta[v_in_preL][w_in_preL] + 1;
                     }
                     tmpCost = (float) size_w * (float) krSum_v + cost2_L[w];
                     if (tmpCost < minCost) {
@@ -1146,8 +1166,8 @@ private:
     }
 
     void computeOptStrategy_postR() {
-        Integer size1 = this->it1->getSize();
-        Integer size2 = this->it2->getSize();
+        Index size1 = this->it1->getSize();
+        Index size2 = this->it2->getSize();
 
         assert(delta.size() == 0);
         delta.resize(size1);
@@ -1161,36 +1181,36 @@ private:
         std::vector<float> cost2_L(size2);
         std::vector<float> cost2_R(size2);
         std::vector<float> cost2_I(size2);
-        std::vector<Integer> cost2_path(size2);
+        std::vector<Index> cost2_path(size2);
         std::vector<float> leafRow(size2);
-        Integer pathIDOffset = size1;
+        Index pathIDOffset = size1;
         float minCost = 0x7fffffffffffffffL;
-        Integer strategyPath = -1;
-
-        std::vector<Integer> &pre2size1 = this->it1->sizes;
-        std::vector<Integer> &pre2size2 = this->it2->sizes;
-        std::vector<Integer> &pre2descSum1 = this->it1->preL_to_desc_sum;
-        std::vector<Integer> &pre2descSum2 = this->it2->preL_to_desc_sum;
-        std::vector<Integer> &pre2krSum1 = this->it1->preL_to_kr_sum;
-        std::vector<Integer> &pre2krSum2 = this->it2->preL_to_kr_sum;
-        std::vector<Integer> &pre2revkrSum1 = this->it1->preL_to_rev_kr_sum;
-        std::vector<Integer> &pre2revkrSum2 = this->it2->preL_to_rev_kr_sum;
-        std::vector<Integer> &preL_to_preR_1 = this->it1->preL_to_preR;
-        std::vector<Integer> &preL_to_preR_2 = this->it2->preL_to_preR;
-        std::vector<Integer> &preR_to_preL_1 = this->it1->preR_to_preL;
-        std::vector<Integer> &preR_to_preL_2 = this->it2->preR_to_preL;
-        std::vector<Integer> &pre2parent1 = this->it1->parents;
-        std::vector<Integer> &pre2parent2 = this->it2->parents;
-        std::vector<bool> &nodeType_L_1 = this->it1->nodeType_L;
-        std::vector<bool> &nodeType_L_2 = this->it2->nodeType_L;
-        std::vector<bool> &nodeType_R_1 = this->it1->nodeType_R;
-        std::vector<bool> &nodeType_R_2 = this->it2->nodeType_R;
-
-        Integer size_v,
+        Index strategyPath = -1;
+
+        Index* pre2size1 = this->it1->sizes;
+        Index* pre2size2 = this->it2->sizes;
+        Sum* pre2descSum1 = this->it1->preL_to_desc_sum;
+        Sum* pre2descSum2 = this->it2->preL_to_desc_sum;
+        Sum* pre2krSum1 = this->it1->preL_to_kr_sum;
+        Sum* pre2krSum2 = this->it2->preL_to_kr_sum;
+        Sum* pre2revkrSum1 = this->it1->preL_to_rev_kr_sum;
+        Sum* pre2revkrSum2 = this->it2->preL_to_rev_kr_sum;
+        Index* preL_to_preR_1 = this->it1->preL_to_preR;
+        Index* preL_to_preR_2 = this->it2->preL_to_preR;
+        Index* preR_to_preL_1 = this->it1->preR_to_preL;
+        Index* preR_to_preL_2 = this->it2->preR_to_preL;
+        Index* pre2parent1 = this->it1->parents;
+        Index* pre2parent2 = this->it2->parents;
+        uint8_t* nodeType_L_1 = this->it1->nodeType_L;
+        uint8_t* nodeType_L_2 = this->it2->nodeType_L;
+        uint8_t* nodeType_R_1 = this->it1->nodeType_R;
+        uint8_t* nodeType_R_2 = this->it2->nodeType_R;
+
+        Index size_v,
             size_w,
             parent_v,
             parent_w;
-        Integer leftPath_v,
+        Index leftPath_v,
             rightPath_v;
         std::vector<float> cost_Lpointer_v,
                            cost_Rpointer_v,
@@ -1198,8 +1218,8 @@ private:
         std::vector<float> cost_Lpointer_parent_v, 
                            cost_Rpointer_parent_v,
                            cost_Ipointer_parent_v;
-        std::vector<float> strategypointer_parent_v;
-        Integer krSum_v, 
+        std::vector<Cost> strategypointer_parent_v;
+        Sum krSum_v, 
             revkrSum_v,
             descSum_v;
         bool is_v_leaf;
@@ -1208,7 +1228,7 @@ private:
         std::stack<std::vector<float>> rowsToReuse_R;
         std::stack<std::vector<float>> rowsToReuse_I;
 
-        for(Integer v = size1 - 1; v >= 0; v--) {
+        for(Index v = size1 - 1; v >= 0; v--) {
             is_v_leaf = this->it1->isLeaf(v);
             parent_v = pre2parent1[v];
 
@@ -1223,7 +1243,7 @@ private:
                 cost1_L[v] = leafRow;
                 cost1_R[v] = leafRow;
                 cost1_I[v] = leafRow;
-                for (Integer i = 0; i < size2; i++) {
+                for (Index i = 0; i < size2; i++) {
                     delta[v][i] = v;
                 }
             }
@@ -1259,9 +1279,9 @@ private:
             fillArray(cost2_L, 0.0f);
             fillArray(cost2_R, 0.0f);
             fillArray(cost2_I, 0.0f);
-            fillArray(cost2_path, (Integer)0);
+            fillArray(cost2_path, (Index)0);
 
-            for (Integer w = size2 - 1; w >= 0; w--) {
+            for (Index w = size2 - 1; w >= 0; w--) {
                 size_w = pre2size2[w];
                 if (this->it2->isLeaf(w)) {
                     cost2_L[w] = 0.0f;
@@ -1290,7 +1310,7 @@ private:
                     tmpCost = (float) size_v * (float) pre2descSum2[w] + cost_Ipointer_v[w];
                     if (tmpCost < minCost) {
                         minCost = tmpCost;
-                        strategyPath = (Integer)delta[v][w] + 1;
+                        strategyPath = (Index)delta[v][w] + 1;
                     }
                     tmpCost = (float) size_w * (float) krSum_v + cost2_L[w];
                     if (tmpCost < minCost) {
@@ -1363,7 +1383,7 @@ private:
         counter = 0L;
 
         // Initialize arrays.
-        Integer maxSize = std::max(this->size1, this->size2) + 1;
+        Index maxSize = std::max(this->size1, this->size2) + 1;
 
         // TODO: Move q initialisation to spfA.
         q.resize(maxSize);
@@ -1374,17 +1394,17 @@ private:
 
         // Compute subtree distances without the root nodes when one of subtrees
         // is a single node.
-        Integer sizeX = -1;
-        Integer sizeY = -1;
-        // Integer parentX = -1;
-        // Integer parentY = -1;
+        Index sizeX = -1;
+        Index sizeY = -1;
+        // Index parentX = -1;
+        // Index parentY = -1;
 
         // Loop over the nodes in reversed left-to-right preorder.
-        for(Integer x = 0; x < this->size1; x++) {
+        for(Index x = 0; x < this->size1; x++) {
             sizeX = this->it1->sizes[x];
             // parentX = this->it1->parents[x];
 
-            for(Integer y = 0; y < this->size2; y++) {
+            for(Index y = 0; y < this->size2; y++) {
                 sizeY = this->it2->sizes[y];
                 // parentY = this->it2->parents[y];
 
@@ -1393,7 +1413,7 @@ private:
                 // In this method we don't have to verify the order of the input trees
                 // because it is equal to the original.
                 if (sizeX == 1 && sizeY == 1) {
-                    delta[x][y] = 0.0f;
+                    delta[x][y] = 0;
                 } else if (sizeX == 1) {
                     delta[x][y] = this->it2->preL_to_sumInsCost[y] - this->costModel->insertCost(this->it2->preL_to_node[y]); // USE COST MODEL.
                 } else if (sizeY == 1) {
@@ -1405,31 +1425,29 @@ private:
 
     //--------------------------------------------------------------------------
 
-    float gted(NodeIndexer<Data>* it1, NodeIndexer<Data>* it2) {
-        Integer currentSubtree1 = it1->getCurrentNode();
-        Integer currentSubtree2 = it2->getCurrentNode();
-        Integer subtreeSize1 = it1->sizes[currentSubtree1];
-        Integer subtreeSize2 = it2->sizes[currentSubtree2];
+    Cost gted(NodeIndexer<Data, Cost, Index>* it1, NodeIndexer<Data, Cost, Index>* it2) {
+        Index currentSubtree1 = it1->getCurrentNode();
+        Index currentSubtree2 = it2->getCurrentNode();
+        Index subtreeSize1 = it1->sizes[currentSubtree1];
+        Index subtreeSize2 = it2->sizes[currentSubtree2];
 
         // Use spf1.
         if ((subtreeSize1 == 1 || subtreeSize2 == 1)) {
             return spf1(it1, currentSubtree1, it2, currentSubtree2);
         }
 
-        Integer strategyPathID = (Integer)delta[currentSubtree1][currentSubtree2];
+        Index strategyPathID = (Index)delta[currentSubtree1][currentSubtree2];
 
-        Integer strategyPathType = -1;
-        Integer currentPathNode = std::abs(strategyPathID) - 1;
-        Integer pathIDOffset = it1->getSize();
+        Index strategyPathType = -1;
+        Index currentPathNode = std::abs(strategyPathID) - 1;
+        Index pathIDOffset = it1->getSize();
 
-        Integer parent = -1;
+        Index parent = -1;
         if(currentPathNode < pathIDOffset) {
             strategyPathType = getStrategyPathType(strategyPathID, pathIDOffset, it1, currentSubtree1, subtreeSize1);
             while((parent = it1->parents[currentPathNode]) >= currentSubtree1) {
-                std::vector<Integer> ai;
-                Integer k = (ai = it1->children[parent]).size();
-                for(Integer i = 0; i < k; i++) {
-                    Integer child = ai[i];
+                for(const Index* c = it1->childrenBegin(parent); c != it1->childrenEnd(parent); c++) {
+                    Index child = *c;
                     if(child != currentPathNode) {
                         it1->setCurrentNode(child);
                         gted(it1, it2);
@@ -1456,10 +1474,8 @@ private:
         currentPathNode -= pathIDOffset;
         strategyPathType = getStrategyPathType(strategyPathID, pathIDOffset, it2, currentSubtree2, subtreeSize2);
         while((parent = it2->parents[currentPathNode]) >= currentSubtree2) {
-            std::vector<Integer> ai1;
-            Integer l = (ai1 = it2->children[parent]).size();
-            for(Integer j = 0; j < l; j++) {
-                Integer child = ai1[j];
+            for(const Index* c = it2->childrenBegin(parent); c != it2->childrenEnd(parent); c++) {
+                Index child = *c;
                 if(child != currentPathNode) {
                     it2->setCurrentNode(child);
                     gted(it1, it2);
@@ -1484,17 +1500,68 @@ private:
         return spfA(it2, it1, std::abs(strategyPathID) - pathIDOffset - 1, strategyPathType, true);
     }
 
-public:
-    Apted(CostModel<Data>* costModel) : TreeEditDistance<Data>(costModel) {
-        // nop
+    //--------------------------------------------------------------------------
+
+    // Computes the forest distances between the subtrees of nodes i and j
+    // (left-to-right postorder ids starting with 1), taking the distances of
+    // all other subtree pairs from delta.
+    Cost forestDist(Index i, Index j, std::vector<std::vector<Cost>> &forestdist) {
+        NodeIndexer<Data, Cost, Index>* it1 = this->it1;
+        NodeIndexer<Data, Cost, Index>* it2 = this->it2;
+        Index lld1 = it1->postL_to_lld[i - 1];
+        Index lld2 = it2->postL_to_lld[j - 1];
+
+        forestdist[lld1][lld2] = 0;
+        for (Index dj = lld2 + 1; dj <= j; dj++) {
+            forestdist[lld1][dj] = forestdist[lld1][dj - 1] + this->costModel->insertCost(it2->postL_to_node(dj - 1));
+        }
+
+        for (Index di = lld1 + 1; di <= i; di++) {
+            Node<Data>* n1 = it1->postL_to_node(di - 1);
+            Cost del = this->costModel->deleteCost(n1);
+            forestdist[di][lld2] = forestdist[di - 1][lld2] + del;
+
+            for (Index dj = lld2 + 1; dj <= j; dj++) {
+                Node<Data>* n2 = it2->postL_to_node(dj - 1);
+                Cost da = forestdist[di - 1][dj] + del;
+                Cost db = forestdist[di][dj - 1] + this->costModel->insertCost(n2);
+                Cost dc = this->costModel->renameCost(n1, n2);
+
+                // If both subforests are subtrees, rename the roots. Otherwise
+                // the last subtrees are mapped to each other, and delta holds
+                // their distance without the roots.
+                if (it1->postL_to_lld[di - 1] == lld1 && it2->postL_to_lld[dj - 1] == lld2) {
+                    dc += forestdist[di - 1][dj - 1];
+                } else {
+                    dc += forestdist[it1->postL_to_lld[di - 1]][it2->postL_to_lld[dj - 1]] + delta[it1->postL_to_preL[di - 1]][it2->postL_to_preL[dj - 1]];
+                }
+
+                forestdist[di][dj] = da >= db ? db >= dc ? dc : db : da >= dc ? dc : da;
+            }
+        }
+
+        return forestdist[i][j];
     }
 
-    virtual float computeEditDistance(Node<Data>* t1, Node<Data>* t2) override {
-        // Index the nodes of both input trees.
-        this->init(t1, t2);
+    // Computes the distance of the indexed trees with APTED.
+    //
+    // Pairs computed before by an instance with the same distance cache and
+    // cost model id are looked up by their hashes instead. Only the pair of
+    // whole trees is looked up: APTED decomposes into pairs of a subtree and
+    // the whole other tree, and the single-path function of a pair reads the
+    // distances of every subtree of one with every subtree of the other from
+    // delta, so an inner pair can't be answered on its own.
+    Cost computeIndexedEditDistance(bool needDelta = false) {
+        uint64_t hash1 = this->it1->getHash(0);
+        uint64_t hash2 = this->it2->getHash(0);
+        double cached;
+        if (!needDelta && distanceCache && distanceCache->find(hash1, this->size1, hash2, this->size2, costModelId, cached)) {
+            return (Cost)cached;
+        }
 
         // Determine the optimal strategy for the distance computation.
         // Use the heuristic from [2, Section 5.3].
+        delta.clear();
         if (this->it1->lchl < this->it1->rchl) {
             computeOptStrategy_postL();
         } else {
@@ -1505,7 +1572,149 @@ public:
         tedInit();
 
         // Compute the distance.
-        return gted(this->it1, this->it2);
+        Cost distance = gted(this->it1, this->it2);
+        deltaComputed = true;
+        if (distanceCache) {
+            distanceCache->insert(hash1, this->size1, hash2, this->size2, costModelId, distance);
+        }
+        return distance;
+    }
+
+public:
+    Apted(CostModel<Data, Cost>* costModel) : TreeEditDistance<Data, Cost, Index>(costModel) {
+        // nop
+    }
+
+    // Enables or disables computing the distance of small pairs of trees with
+    // SmallTreeDistance. Enabled by default.
+    void setSmallTreeRouting(bool enabled) {
+        routeSmallTrees = enabled;
+    }
+
+    // Looks up the distances of pairs of indexed trees in cache before
+    // computing them, and stores the computed ones. Instances sharing the
+    // cache with the same cost model id have to use equal cost models. Pairs
+    // of small trees are cheaper to compute than to hash and are not cached.
+    void setDistanceCache(DistanceCache* cache, uint32_t costModelId) {
+        distanceCache = cache;
+        this->costModelId = costModelId;
+    }
+
+    virtual Cost computeEditDistance(Node<Data>* t1, Node<Data>* t2) override {
+        input1 = t1;
+        input2 = t2;
+        deltaComputed = false;
+
+        // Tiny pairs are cheaper to compute without indexing and strategy.
+        Cost distance;
+        if (routeSmallTrees && SmallTreeDistance<Data, Cost, SMALL_TREE_SIZE>::compute(this->costModel, t1, t2, distance)) {
+            return distance;
+        }
+
+        // Index the nodes of both input trees.
+        this->init(t1, t2);
+        return computeIndexedEditDistance();
+    }
+
+    // Computes the distance of trees indexed by the caller, e.g. views of a
+    // corpus index. The indexers have to be built with the cost model of this
+    // instance, and have to outlive any edit mapping of this pair.
+    Cost computeEditDistance(NodeIndexer<Data, Cost, Index>* it1, NodeIndexer<Data, Cost, Index>* it2) {
+        input1 = nullptr;
+        input2 = nullptr;
+        deltaComputed = false;
+
+        this->init(it1, it2);
+        return computeIndexedEditDistance();
+    }
+
+    /**
+     * Computes an optimal edit mapping of the trees of the last call of
+     * computeEditDistance by backtracking through the forest distances, with
+     * the subtree distances from delta. The distance is not recomputed, unless
+     * the pair went to SmallTreeDistance or the distance cache, which keep no
+     * subtree distances.
+     *
+     * <p>Nodes are given by their left-to-right preorder ids. A deleted node is
+     * paired with -1 on the right, an inserted node with -1 on the left.
+     *
+     * @return an optimal edit mapping.
+     */
+    std::vector<IntPair> computeEditMapping() {
+        if (!deltaComputed) {
+            // Indexers of the caller are still in place.
+            if (input1) {
+                this->init(input1, input2);
+            }
+            computeIndexedEditDistance(true);
+        }
+
+        NodeIndexer<Data, Cost, Index>* it1 = this->it1;
+        NodeIndexer<Data, Cost, Index>* it2 = this->it2;
+        Index size1 = this->size1;
+        Index size2 = this->size2;
+
+        std::vector<std::vector<Cost>> forestdist(size1 + 1, std::vector<Cost>(size2 + 1));
+        std::vector<IntPair> editMapping;
+
+        // Subtree pairs (left-to-right postorder ids starting with 1) whose
+        // forest distances remain to be backtracked.
+        std::vector<std::pair<Index, Index>> treePairs;
+        treePairs.push_back(std::make_pair(size1, size2));
+
+        while (!treePairs.empty()) {
+            Index lastRow = treePairs.back().first;
+            Index lastCol = treePairs.back().second;
+            treePairs.pop_back();
+
+            forestDist(lastRow, lastCol, forestdist);
+
+            Index firstRow = it1->postL_to_lld[lastRow - 1];
+            Index firstCol = it2->postL_to_lld[lastCol - 1];
+            Index row = lastRow;
+            Index col = lastCol;
+
+            while (row > firstRow || col > firstCol) {
+                if (row > firstRow && forestdist[row - 1][col] + this->costModel->deleteCost(it1->postL_to_node(row - 1)) == forestdist[row][col]) {
+                    // Node row is deleted from the left-hand tree.
+                    editMapping.push_back(IntPair(it1->postL_to_preL[row - 1], -1));
+                    row--;
+                } else if (col > firstCol && forestdist[row][col - 1] + this->costModel->insertCost(it2->postL_to_node(col - 1)) == forestdist[row][col]) {
+                    // Node col is inserted into the right-hand tree.
+                    editMapping.push_back(IntPair(-1, it2->postL_to_preL[col - 1]));
+                    col--;
+                } else if (it1->postL_to_lld[row - 1] == firstRow && it2->postL_to_lld[col - 1] == firstCol) {
+                    // Both subforests are trees: node row is renamed to node col.
+                    editMapping.push_back(IntPair(it1->postL_to_preL[row - 1], it2->postL_to_preL[col - 1]));
+                    row--;
+                    col--;
+                } else {
+                    // The last subtrees are mapped to each other; continue with
+                    // the forests to their left.
+                    treePairs.push_back(std::make_pair(row, col));
+                    row = it1->postL_to_lld[row - 1];
+                    col = it2->postL_to_lld[col - 1];
+                }
+            }
+        }
+
+        return editMapping;
+    }
+
+    // Sums up the costs of the edit operations of a mapping computed for the
+    // trees of the last call of computeEditMapping.
+    Cost mappingCost(const std::vector<IntPair> &mapping) {
+        Cost cost = 0;
+        for (IntPair e : mapping) {
+            if (e.first > -1 && e.second > -1) {
+                cost += this->costModel->renameCost(this->it1->preL_to_node[e.first], this->it2->preL_to_node[e.second]);
+            } else if (e.first > -1) {
+                cost += this->costModel->deleteCost(this->it1->preL_to_node[e.first]);
+            } else {
+                cost += this->costModel->insertCost(this->it2->preL_to_node[e.second]);
+            }
+        }
+        return cost;
     }
 };
 
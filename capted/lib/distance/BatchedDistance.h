@@ -0,0 +1,343 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include "node/NodeIndexer.h"
+#include "util/int.h"
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Distance Algorithm (batched)
+//------------------------------------------------------------------------------
+
+/**
+ * Unit cost tree edit distances between one query tree and many candidate
+ * trees, computed Lanes candidates at a time. Deleting or inserting a node
+ * costs one, renaming costs one if the interned labels differ.
+ *
+ * <p>This is Zhang and Shasha's algorithm. The query tree drives the loops,
+ * while every table entry holds one value per candidate ("lane"), so the
+ * innermost loop runs over the lanes with the same operations for each lane
+ * and is vectorized by the compiler. The lanes of a batch are padded to the
+ * largest candidate of the batch; candidates are sorted by size, so that a
+ * batch holds trees of similar size.
+ *
+ * <p>Distances are 16-bit, so the query size plus the candidate size must not
+ * exceed 32767. Query and candidates have to be indexed with the same label
+ * dictionary.
+ *
+ * @param <D> type of node data.
+ * @param <C> type of costs of the indexers.
+ * @param <I> type of node ids of the indexers.
+ * @param <L> number of candidates per batch.
+ */
+template<class Data, class Cost = float, class Index = Integer, int Lanes = 16>
+class BatchedDistance {
+private:
+    typedef NodeIndexer<Data, Cost, Index> Indexer;
+    typedef int16_t Cell;
+
+    // Padding label; interned labels are not negative.
+    static const int32_t NO_LABEL = -1;
+
+    // The query tree in left-to-right postorder.
+    std::vector<int32_t> lld1;
+    std::vector<int32_t> label1;
+    std::vector<int32_t> keyRoots1;
+
+    // The candidates of the current batch in left-to-right postorder, lane
+    // minor: entry [j * Lanes + lane].
+    std::vector<int32_t> lld2;
+    std::vector<int32_t> label2;
+    std::vector<int32_t> keyRoots2;
+    Integer sizes2[Lanes];
+    Integer keyRootCounts2[Lanes];
+
+    // The k-th keyroot subtree of each lane, indexed by the position b of a
+    // node within the subtree: [b * Lanes + lane].
+    std::vector<int32_t> subtreeLabel;
+    std::vector<int32_t> subtreeLld;
+    std::vector<int32_t> subtreeNode;
+
+    std::vector<Cell> forestdist;
+    std::vector<Cell> treedist;
+    std::vector<Cell> matchBuffer;
+
+    static void checkLabels(Indexer* it) {
+        if (!it->hasLabels()) {
+            printf("Batched distance needs labeled indexers in %s::%d\n", __FILE__, __LINE__);
+            exit(1);
+        }
+    }
+
+    // A node is a keyroot if it is the root or has a left sibling.
+    static bool isKeyRoot(Indexer* it, Index preL) {
+        return preL == 0 || !it->nodeType_L[preL];
+    }
+
+    void loadQuery(Indexer* it) {
+        Integer size = it->getSize();
+
+        lld1.resize(size);
+        label1.resize(size);
+        keyRoots1.clear();
+        for (Integer i = 0; i < size; i++) {
+            Index preL = it->postL_to_preL[i];
+            lld1[i] = it->postL_to_lld[i];
+            label1[i] = it->preL_to_label[preL];
+            if (isKeyRoot(it, preL)) {
+                keyRoots1.push_back(i);
+            }
+        }
+    }
+
+    // Loads up to Lanes candidates. Empty lanes repeat the first candidate.
+    Integer loadBatch(Indexer** batch, Integer count) {
+        Integer maxSize = 0;
+        Integer maxKeyRoots = 0;
+        for (Integer lane = 0; lane < count; lane++) {
+            maxSize = std::max(maxSize, (Integer)batch[lane]->getSize());
+        }
+
+        lld2.assign(maxSize * Lanes, 0);
+        label2.assign(maxSize * Lanes, NO_LABEL);
+        keyRoots2.clear();
+
+        for (Integer lane = 0; lane < Lanes; lane++) {
+            Indexer* it = batch[lane < count ? lane : 0];
+            Integer size = it->getSize();
+            sizes2[lane] = size;
+            keyRootCounts2[lane] = 0;
+
+            for (Integer j = 0; j < size; j++) {
+                Index preL = it->postL_to_preL[j];
+                lld2[j * Lanes + lane] = it->postL_to_lld[j];
+                label2[j * Lanes + lane] = it->preL_to_label[preL];
+                if (isKeyRoot(it, preL)) {
+                    keyRootCounts2[lane]++;
+                }
+            }
+            maxKeyRoots = std::max(maxKeyRoots, keyRootCounts2[lane]);
+        }
+
+        // The keyroots of each lane are ordered by subtree size, which keeps
+        // all subtrees inside a keyroot subtree before it, and aligns subtrees
+        // of similar size across the lanes. Lanes with fewer keyroots start by
+        // repeating their first keyroot, whose subtree contains no other.
+        keyRoots2.resize(maxKeyRoots * Lanes);
+        std::vector<Integer> laneKeyRoots;
+        for (Integer lane = 0; lane < Lanes; lane++) {
+            Indexer* it = batch[lane < count ? lane : 0];
+            laneKeyRoots.clear();
+            for (Integer j = 0; j < sizes2[lane]; j++) {
+                if (isKeyRoot(it, it->postL_to_preL[j])) {
+                    laneKeyRoots.push_back(j);
+                }
+            }
+            std::stable_sort(laneKeyRoots.begin(), laneKeyRoots.end(), [&](Integer x, Integer y) {
+                return x - lld2[x * Lanes + lane] < y - lld2[y * Lanes + lane];
+            });
+
+            Integer padding = maxKeyRoots - laneKeyRoots.size();
+            for (Integer k = 0; k < maxKeyRoots; k++) {
+                keyRoots2[k * Lanes + lane] = laneKeyRoots[k < padding ? 0 : k - padding];
+            }
+        }
+
+        return maxSize;
+    }
+
+    // Gathers the k-th keyroot subtree of every lane by position, so that the
+    // forest distance loops index all lanes alike. Positions past the end of a
+    // lane's subtree are padding: they are not subtree roots and point to the
+    // spare column maxSize of treedist. Returns the longest subtree.
+    Integer loadSubtrees(Integer k, Integer maxSize) {
+        Integer maxLength = 0;
+        for (Integer lane = 0; lane < Lanes; lane++) {
+            Integer j = keyRoots2[k * Lanes + lane];
+            Integer lj = lld2[j * Lanes + lane];
+            maxLength = std::max(maxLength, j - lj + 1);
+        }
+
+        subtreeLabel.resize((maxLength + 1) * Lanes);
+        subtreeLld.resize((maxLength + 1) * Lanes);
+        subtreeNode.resize((maxLength + 1) * Lanes);
+        matchBuffer.resize((maxLength + 1) * Lanes);
+
+        for (Integer lane = 0; lane < Lanes; lane++) {
+            Integer j = keyRoots2[k * Lanes + lane];
+            Integer lj = lld2[j * Lanes + lane];
+
+            for (Integer b = 1; b <= maxLength; b++) {
+                Integer j1 = lj + b - 1;
+                Integer cell = b * Lanes + lane;
+                if (j1 <= j) {
+                    subtreeLabel[cell] = label2[j1 * Lanes + lane];
+                    subtreeLld[cell] = lld2[j1 * Lanes + lane] - lj;
+                    subtreeNode[cell] = j1;
+                } else {
+                    subtreeLabel[cell] = NO_LABEL;
+                    subtreeLld[cell] = b - 1;
+                    subtreeNode[cell] = maxSize;
+                }
+            }
+        }
+
+        return maxLength;
+    }
+
+    static inline Cell min3(Cell a, Cell b, Cell c) {
+        Cell m = a < b ? a : b;
+        return m < c ? m : c;
+    }
+
+    // The distance of the part of a subforest pair that precedes the last
+    // subtrees, plus the distance of those subtrees, for positions 1 to
+    // maxLength of all lanes. The reads depend on the shape of each candidate,
+    // so they are gathered in a loop of their own, which writes a separate
+    // buffer and leaves the loop over the forest distances free of indirect
+    // accesses.
+    static void gatherMatches(Cell* __restrict matches, const Cell* __restrict jump, const Cell* __restrict treedistRow,
+            const int32_t* __restrict llds, const int32_t* __restrict nodes, Integer maxLength) {
+        for (Integer cell = Lanes; cell < (maxLength + 1) * Lanes; cell++) {
+            Integer lane = cell % Lanes;
+            matches[cell] = jump[llds[cell] * Lanes + lane] + treedistRow[nodes[cell] * Lanes + lane];
+        }
+    }
+
+    // One row of forest distances: node i1 of the query subtree with leftmost
+    // leaf li against positions 1 to maxLength of all lanes.
+    void computeRow(Integer i1, Integer li, Integer maxLength, Integer width) {
+        Integer a = i1 - li + 1;
+        Integer lldI1 = lld1[i1];
+        int32_t l1 = label1[i1];
+
+        Cell* current = &forestdist[a * width];
+        const Cell* previous = current - width;
+        Cell* treedistRow = &treedist[i1 * width];
+        const Cell* matches = matchBuffer.data();
+        const int32_t* labels = subtreeLabel.data();
+        const int32_t* llds = subtreeLld.data();
+        const int32_t* nodes = subtreeNode.data();
+
+        gatherMatches(matchBuffer.data(), &forestdist[(lldI1 - li) * width], treedistRow, llds, nodes, maxLength);
+
+        // If the query subforest is a subtree, the lanes whose subforest is a
+        // subtree too rename, and store the result as a tree distance.
+        if (lldI1 == li) {
+            for (Integer b = 1; b <= maxLength; b++) {
+                for (Integer lane = 0; lane < Lanes; lane++) {
+                    Integer cell = b * Lanes + lane;
+                    Cell da = previous[cell] + 1;
+                    Cell db = current[cell - Lanes] + 1;
+                    Cell rename = previous[cell - Lanes] + (labels[cell] != l1);
+                    current[cell] = min3(da, db, llds[cell] == 0 ? rename : matches[cell]);
+                }
+            }
+            for (Integer cell = Lanes; cell < (maxLength + 1) * Lanes; cell++) {
+                if (llds[cell] == 0) {
+                    treedistRow[nodes[cell] * Lanes + cell % Lanes] = current[cell];
+                }
+            }
+        } else {
+            for (Integer b = 1; b <= maxLength; b++) {
+                for (Integer lane = 0; lane < Lanes; lane++) {
+                    Integer cell = b * Lanes + lane;
+                    Cell da = previous[cell] + 1;
+                    Cell db = current[cell - Lanes] + 1;
+                    current[cell] = min3(da, db, matches[cell]);
+                }
+            }
+        }
+    }
+
+    void computeBatch(Indexer** batch, Integer count, Integer* results) {
+        Integer size1 = lld1.size();
+        Integer maxSize = loadBatch(batch, count);
+
+        if (size1 + maxSize > std::numeric_limits<Cell>::max()) {
+            printf("Trees too large for batched distance in %s::%d\n", __FILE__, __LINE__);
+            exit(1);
+        }
+
+        // One spare column for padding positions.
+        Integer width = (maxSize + 1) * Lanes;
+        forestdist.resize((size1 + 1) * width);
+        treedist.resize(size1 * width);
+
+        Integer maxKeyRoots = keyRoots2.size() / Lanes;
+        for (Integer k = 0; k < maxKeyRoots; k++) {
+            Integer maxLength = loadSubtrees(k, maxSize);
+
+            for (Integer i : keyRoots1) {
+                Integer li = lld1[i];
+
+                for (Integer a = 0; a <= i - li + 1; a++) {
+                    for (Integer lane = 0; lane < Lanes; lane++) {
+                        forestdist[a * width + lane] = a;
+                    }
+                }
+                for (Integer b = 1; b <= maxLength; b++) {
+                    for (Integer lane = 0; lane < Lanes; lane++) {
+                        forestdist[b * Lanes + lane] = b;
+                    }
+                }
+
+                for (Integer i1 = li; i1 <= i; i1++) {
+                    computeRow(i1, li, maxLength, width);
+                }
+            }
+        }
+
+        for (Integer lane = 0; lane < count; lane++) {
+            results[lane] = treedist[(size1 - 1) * width + (sizes2[lane] - 1) * Lanes + lane];
+        }
+    }
+
+public:
+    // Returns the distances between the query and each candidate, in the order
+    // of the candidates.
+    std::vector<Integer> computeEditDistances(Indexer* query, const std::vector<Indexer*> &candidates) {
+        checkLabels(query);
+        for (Indexer* candidate : candidates) {
+            checkLabels(candidate);
+        }
+
+        // Size classes: batches of candidates of similar size.
+        std::vector<Indexer*> sorted(candidates);
+        std::vector<Integer> order(candidates.size());
+        for (Integer c = 0; c < (Integer)order.size(); c++) {
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](Integer x, Integer y) {
+            return candidates[x]->getSize() < candidates[y]->getSize();
+        });
+        for (Integer c = 0; c < (Integer)order.size(); c++) {
+            sorted[c] = candidates[order[c]];
+        }
+
+        loadQuery(query);
+
+        std::vector<Integer> sortedResults(candidates.size());
+        for (Integer first = 0; first < (Integer)sorted.size(); first += Lanes) {
+            Integer count = std::min((Integer)Lanes, (Integer)sorted.size() - first);
+            computeBatch(&sorted[first], count, &sortedResults[first]);
+        }
+
+        std::vector<Integer> results(candidates.size());
+        for (Integer c = 0; c < (Integer)order.size(); c++) {
+            results[order[c]] = sortedResults[c];
+        }
+        return results;
+    }
+};
+
+template<class Data, class Cost, class Index, int Lanes>
+const int32_t BatchedDistance<Data, Cost, Index, Lanes>::NO_LABEL;
+
+} // namespace capted
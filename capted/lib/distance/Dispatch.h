@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include "Apted.h"
+#include "util/int.h"
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Index Width Selection
+//------------------------------------------------------------------------------
+
+enum class IndexWidth {
+    Int16,
+    Int32,
+    Int64
+};
+
+// Node ids of both trees and the strategy path ids (offset by the size of the
+// left-hand tree) have to fit the index type. The algorithm relies on -1 and
+// on negative path ids, so the index types are signed.
+inline IndexWidth selectIndexWidth(int64_t size1, int64_t size2) {
+    int64_t required = size1 + size2 + 2;
+
+    if (required <= std::numeric_limits<int16_t>::max()) {
+        return IndexWidth::Int16;
+    }
+    if (required <= std::numeric_limits<int32_t>::max()) {
+        return IndexWidth::Int32;
+    }
+    return IndexWidth::Int64;
+}
+
+//------------------------------------------------------------------------------
+// Distance Dispatch
+//------------------------------------------------------------------------------
+
+// Computes the distance with APTED instantiated for the narrowest index type
+// that fits the input trees.
+template<class Data, class Cost>
+Cost dispatchEditDistance(CostModel<Data, Cost>* costModel, Node<Data>* t1, Node<Data>* t2) {
+    switch (selectIndexWidth(t1->getNodeCount(), t2->getNodeCount())) {
+        case IndexWidth::Int16: {
+            Apted<Data, Cost, int16_t> algorithm(costModel);
+            return algorithm.computeEditDistance(t1, t2);
+        }
+        case IndexWidth::Int32: {
+            Apted<Data, Cost, int32_t> algorithm(costModel);
+            return algorithm.computeEditDistance(t1, t2);
+        }
+        default: {
+            Apted<Data, Cost, int64_t> algorithm(costModel);
+            return algorithm.computeEditDistance(t1, t2);
+        }
+    }
+}
+
+// Same as above for a family of cost models over the cost type whose costs are
+// integers no larger than one per node (e.g. BasicStringCostModel). Then no
+// distance exceeds the sum of the tree sizes, and the distance tables use the
+// index width too. The models of the family give the same distances, so all
+// widths share the entries of an optional distance cache under one id.
+template<template<class> class UnitCostModel, class Data>
+int64_t dispatchUnitCostEditDistance(Node<Data>* t1, Node<Data>* t2, DistanceCache* cache = nullptr, uint32_t costModelId = 0) {
+    switch (selectIndexWidth(t1->getNodeCount(), t2->getNodeCount())) {
+        case IndexWidth::Int16: {
+            UnitCostModel<int16_t> costModel;
+            Apted<Data, int16_t, int16_t> algorithm(&costModel);
+            algorithm.setDistanceCache(cache, costModelId);
+            return algorithm.computeEditDistance(t1, t2);
+        }
+        case IndexWidth::Int32: {
+            UnitCostModel<int32_t> costModel;
+            Apted<Data, int32_t, int32_t> algorithm(&costModel);
+            algorithm.setDistanceCache(cache, costModelId);
+            return algorithm.computeEditDistance(t1, t2);
+        }
+        default: {
+            UnitCostModel<int64_t> costModel;
+            Apted<Data, int64_t, int64_t> algorithm(&costModel);
+            algorithm.setDistanceCache(cache, costModelId);
+            return algorithm.computeEditDistance(t1, t2);
+        }
+    }
+}
+
+} // namespace capted
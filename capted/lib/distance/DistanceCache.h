@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Distance Cache
+//------------------------------------------------------------------------------
+
+/**
+ * Distances of pairs of trees by their structural hashes (see NodeIndexer),
+ * their sizes and the id of the cost model, so that a pair that recurs across
+ * comparisons is computed once: duplicate files of a corpus, or functions
+ * that recur across files when they are compared function by function. Trees
+ * with equal hashes and sizes are taken to be identical; the sizes make a
+ * collision of 64-bit hashes answer with a wrong distance only if the trees
+ * are as large as well.
+ *
+ * <p>Apted looks up the pairs it is asked for as a whole, not the subtree
+ * pairs within them (see Apted::computeIndexedEditDistance). Callers that
+ * split trees into subtrees, like function by function comparison, look up
+ * the pairs of subtrees themselves.
+ *
+ * <p>The cache is split into shards with a lock each, so that threads mostly
+ * don't wait for each other, and holds at most a given number of distances;
+ * each shard evicts its least recently used one. Distances are kept as
+ * doubles, which hold every cost of the cost types of Apted exactly, so one
+ * cache serves instances of any cost and index type.
+ */
+class DistanceCache {
+private:
+    struct Key {
+        uint64_t hash1;
+        uint64_t hash2;
+        int64_t size1;
+        int64_t size2;
+        uint32_t costModel;
+
+        bool operator==(const Key &other) const {
+            return hash1 == other.hash1 && hash2 == other.hash2 && size1 == other.size1 && size2 == other.size2
+                && costModel == other.costModel;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            return key.hash1 ^ (key.hash2 << 17 | key.hash2 >> 47) ^ key.costModel ^ key.size1 << 32 ^ key.size2;
+        }
+    };
+
+    typedef std::pair<Key, double> Entry;
+
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used first.
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> positions;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardCapacity;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    Shard &shardOf(const Key &key) {
+        // The hashes are mixed already; the high bits are free of KeyHash's.
+        return *shards[(key.hash1 >> 40 ^ key.hash2 >> 52) % shards.size()];
+    }
+
+public:
+    DistanceCache(size_t capacity, size_t shardCount = 16)
+    : shardCapacity(std::max<size_t>(capacity / std::max<size_t>(shardCount, 1), 1))
+    , hits(0)
+    , misses(0) {
+        for (size_t i = 0; i < std::max<size_t>(shardCount, 1); i++) {
+            shards.emplace_back(new Shard());
+        }
+    }
+
+    DistanceCache(const DistanceCache &) = delete;
+    DistanceCache &operator=(const DistanceCache &) = delete;
+
+    // Returns whether the distance of the pair of trees with the given hashes
+    // and sizes is known, and if so sets it.
+    bool find(uint64_t hash1, int64_t size1, uint64_t hash2, int64_t size2, uint32_t costModel, double &distance) {
+        Key key = {hash1, hash2, size1, size2, costModel};
+        Shard &shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto found = shard.positions.find(key);
+        if (found == shard.positions.end()) {
+            misses++;
+            return false;
+        }
+
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        distance = found->second->second;
+        hits++;
+        return true;
+    }
+
+    void insert(uint64_t hash1, int64_t size1, uint64_t hash2, int64_t size2, uint32_t costModel, double distance) {
+        Key key = {hash1, hash2, size1, size2, costModel};
+        Shard &shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto found = shard.positions.find(key);
+        if (found != shard.positions.end()) {
+            found->second->second = distance;
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            return;
+        }
+
+        if (shard.entries.size() >= shardCapacity) {
+            shard.positions.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+        }
+        shard.entries.push_front({key, distance});
+        shard.positions.emplace(key, shard.entries.begin());
+    }
+
+    uint64_t getHits() const {
+        return hits;
+    }
+
+    uint64_t getMisses() const {
+        return misses;
+    }
+
+    // The share of lookups that found a distance, 0 before any lookup.
+    double getHitRate() const {
+        uint64_t lookups = hits + misses;
+        return lookups == 0 ? 0 : (double)hits / lookups;
+    }
+};
+
+} // namespace capted
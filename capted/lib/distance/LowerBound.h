@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "node/TreeProfile.h"
+#include "util/int.h"
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Lower Bounds (unit costs)
+//------------------------------------------------------------------------------
+
+// Lower bounds on the tree edit distance under unit costs (deletion and
+// insertion cost one, renaming costs one for different labels). They are
+// cheaper than the distance, so they filter out pairs of trees that are
+// certainly farther apart than some budget.
+
+// A mapping of m node pairs costs n1 + n2 - 2m plus one per pair with
+// different labels, and at most |bag1 ∩ bag2| pairs have equal labels. That is
+// at least max(n1, n2) - |bag1 ∩ bag2|, which also covers |n1 - n2|.
+inline Integer labelBagLowerBound(const int32_t* bag1, Integer size1, const int32_t* bag2, Integer size2) {
+    Integer common = 0;
+    Integer i = 0;
+    Integer j = 0;
+
+    while (i < size1 && j < size2) {
+        if (bag1[i] < bag2[j]) {
+            i++;
+        } else if (bag2[j] < bag1[i]) {
+            j++;
+        } else {
+            common++;
+            i++;
+            j++;
+        }
+    }
+
+    return std::max(size1, size2) - common;
+}
+
+template<class Data>
+Integer labelBagLowerBound(const TreeProfile<Data> &p1, const TreeProfile<Data> &p2) {
+    return labelBagLowerBound(p1.labelBag, p1.size, p2.labelBag, p2.size);
+}
+
+// Returns the string edit distance of the sequences, or bound + 1 if it
+// exceeds bound. Only the band of cells within bound of the diagonal is
+// computed, and the computation stops as soon as a whole row exceeds bound.
+inline Integer boundedSequenceDistance(const int32_t* s1, Integer n1, const int32_t* s2, Integer n2, Integer bound) {
+    Integer exceeded = bound + 1;
+
+    if (std::abs(n1 - n2) > bound) {
+        return exceeded;
+    }
+
+    // Cells outside the band count as exceeded.
+    std::vector<Integer> previous(n2 + 1, exceeded);
+    std::vector<Integer> current(n2 + 1, exceeded);
+    for (Integer j = 0; j <= std::min(n2, bound); j++) {
+        previous[j] = j;
+    }
+
+    for (Integer i = 1; i <= n1; i++) {
+        Integer first = std::max((Integer)1, i - bound);
+        Integer last = std::min(n2, i + bound);
+        Integer rowMin = exceeded;
+
+        current[first - 1] = first == 1 && i <= bound ? i : exceeded;
+        for (Integer j = first; j <= last; j++) {
+            Integer value = previous[j - 1] + (s1[i - 1] != s2[j - 1]);
+            value = std::min(value, previous[j] + 1);
+            value = std::min(value, current[j - 1] + 1);
+            current[j] = std::min(value, exceeded);
+            rowMin = std::min(rowMin, current[j]);
+        }
+        if (last < n2) {
+            current[last + 1] = exceeded;
+        }
+
+        if (std::min(rowMin, current[first - 1]) > bound) {
+            return exceeded;
+        }
+        std::swap(previous, current);
+    }
+
+    return previous[n2];
+}
+
+// The string edit distance of the left-to-right preorder (or postorder) label
+// sequences is at most the tree edit distance [1]. Returns the larger of both,
+// or bound + 1 as soon as one exceeds bound.
+//
+// [1] S. Guha, H. V. Jagadish, N. Koudas, D. Srivastava and T. Yu. Approximate
+//     XML joins. SIGMOD 2002.
+template<class Data>
+Integer traversalLowerBound(const TreeProfile<Data> &p1, const TreeProfile<Data> &p2, Integer bound) {
+    Integer pre = boundedSequenceDistance(p1.preorder, p1.size, p2.preorder, p2.size, bound);
+    if (pre > bound) {
+        return pre;
+    }
+    return std::max(pre, boundedSequenceDistance(p1.postorder, p1.size, p2.postorder, p2.size, bound));
+}
+
+} // namespace capted
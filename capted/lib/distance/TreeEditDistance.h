@@ -12,36 +12,63 @@ namespace capted {
 
 typedef std::pair<Integer, Integer> IntPair;
 
-template<class Data>
+template<class Data, class Cost = float, class Index = Integer>
 class TreeEditDistance {
 protected:
-    NodeIndexer<Data>* it1;
-    NodeIndexer<Data>* it2;
-    Integer size1;
-    Integer size2;
-    const CostModel<Data>* costModel;
+    NodeIndexer<Data, Cost, Index>* it1;
+    NodeIndexer<Data, Cost, Index>* it2;
+    Index size1;
+    Index size2;
+    const CostModel<Data, Cost>* costModel;
+    bool ownsIndexers;
+
+    void releaseIndexers() {
+        if (ownsIndexers) {
+            delete it1;
+            delete it2;
+        }
+        it1 = nullptr;
+        it2 = nullptr;
+    }
 
     void init(Node<Data>* t1, Node<Data>* t2) {
-        it1 = new NodeIndexer<Data>(t1, costModel);
-        it2 = new NodeIndexer<Data>(t2, costModel);
+        releaseIndexers();
+        it1 = new NodeIndexer<Data, Cost, Index>(t1, costModel);
+        it2 = new NodeIndexer<Data, Cost, Index>(t2, costModel);
+        ownsIndexers = true;
+        size1 = it1->getSize();
+        size2 = it2->getSize();
+    }
+
+    // Uses indexers of the caller, e.g. views of a corpus index, which are not
+    // deleted.
+    void init(NodeIndexer<Data, Cost, Index>* t1, NodeIndexer<Data, Cost, Index>* t2) {
+        releaseIndexers();
+        it1 = t1;
+        it2 = t2;
+        ownsIndexers = false;
+        it1->resolveNodes();
+        it2->resolveNodes();
+        it1->setCurrentNode(0);
+        it2->setCurrentNode(0);
         size1 = it1->getSize();
         size2 = it2->getSize();
     }
 
 public:
-    TreeEditDistance(CostModel<Data>* costModel) : costModel(costModel) {
+    TreeEditDistance(CostModel<Data, Cost>* costModel) : costModel(costModel) {
         it1 = nullptr;
         it2 = nullptr;
+        ownsIndexers = true;
         size1 = -1;
         size2 = -1;
     }
 
     ~TreeEditDistance() {
-        delete it1;
-        delete it2;
+        releaseIndexers();
     }
 
-    virtual float computeEditDistance(Node<Data>* t1, Node<Data>* t2) = 0;
+    virtual Cost computeEditDistance(Node<Data>* t1, Node<Data>* t2) = 0;
 };
 
 } // namespace capted
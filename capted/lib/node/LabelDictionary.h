@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "Node.h"
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Label Dictionary
+//------------------------------------------------------------------------------
+
+// Interns node labels to dense integer ids, so that label equality is an
+// integer comparison. Data has to provide getLabel(). Share one dictionary
+// between all trees whose labels are compared.
+//
+// The dictionary also keeps one canonical node per label, which stands in for
+// the nodes of trees that are known only by their labels (see the view
+// constructor of NodeIndexer). Data has to be constructible from the label for
+// these.
+template<class Data>
+class LabelDictionary {
+private:
+    std::unordered_map<std::string, int32_t> ids;
+    std::vector<std::string> labels;
+    std::vector<Node<Data>*> nodes;
+
+public:
+    LabelDictionary() {
+        // nop
+    }
+
+    LabelDictionary(const LabelDictionary &) = delete;
+    LabelDictionary &operator=(const LabelDictionary &) = delete;
+
+    ~LabelDictionary() {
+        for (Node<Data>* node : nodes) {
+            delete node;
+        }
+    }
+
+    int32_t intern(const std::string &label) {
+        auto found = ids.find(label);
+        if (found != ids.end()) {
+            return found->second;
+        }
+
+        int32_t id = labels.size();
+        ids.emplace(label, id);
+        labels.push_back(label);
+        return id;
+    }
+
+    int32_t intern(Node<Data>* node) {
+        return intern(node->getData()->getLabel());
+    }
+
+    const std::string &getLabel(int32_t id) const {
+        return labels[id];
+    }
+
+    Node<Data>* getNode(int32_t id) {
+        if (nodes.size() < labels.size()) {
+            nodes.resize(labels.size(), nullptr);
+        }
+        if (!nodes[id]) {
+            nodes[id] = new Node<Data>(new Data(labels[id]));
+        }
+        return nodes[id];
+    }
+
+    int32_t size() const {
+        return labels.size();
+    }
+};
+
+} // namespace capted
@@ -1,9 +1,18 @@
 #pragma once
 
 #include <vector>
+#include <list>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
 #include "util/debug.h"
 #include "util/int.h"
+#include "LabelDictionary.h"
+#include "TreeHash.h"
+#include "TreeStore.h"
 
 namespace capted {
 
@@ -25,6 +34,20 @@ namespace capted {
  * <li>right-to-left postorder [2].
  * </ul>
  *
+ * <p>Every subtree also gets a structural (Merkle) hash of its labels and
+ * shape: the hash of its root label combined with the hashes of its children
+ * in order. Identical subtrees have equal hashes, so unequal hashes rule out
+ * identity at once.
+ *
+ * <p>Besides a {@link node.Node} tree, the indexer takes the tree of a root of
+ * a TreeStore, whose subtrees may be shared with other trees. Its nodes are
+ * then the canonical nodes of the labels, as in a view.
+ *
+ * <p>If a label dictionary is given, the indexer also stores the interned
+ * label of every node. The arena of a labeled indexer holds no pointers, so it
+ * can be written to a file and used in place by a view (see the view
+ * constructor), e.g. from a memory-mapped corpus index.
+ *
  * <p>See the source code for more algorithm-related comments.
  *
  * <p>References:
@@ -36,318 +59,533 @@ namespace capted {
  * </ul>
  *
  * @param <D> type of node data.
- * @param <C> type of cost model.
+ * @param <C> type of costs.
+ * @param <I> type of node ids; it has to hold the size of the tree.
  * @see node.Node
  * @see parser.InputParser
  */
 
-template <class NodeData>
+template <class NodeData, class Cost, class Index>
 class AllPossibleMappings;
 
-template <class NodeData>
+template <class NodeData, class Cost, class Index>
 class Apted;
 
-template<class Data>
+template <class NodeData, class Cost, class Index, int Lanes>
+class BatchedDistance;
+
+template<class Data, class Cost = float, class Index = Integer>
 class NodeIndexer {
+public:
+    typedef typename WideInteger<Index>::type Sum;
+
 private:
     typedef Node<Data> N;
 
-    friend AllPossibleMappings<Data>;
-    friend Apted<Data>;
-
-    const CostModel<Data>* costModel;
-    const Integer treeSize;
+    friend AllPossibleMappings<Data, Cost, Index>;
+    friend Apted<Data, Cost, Index>;
+    template <class, class, class, int> friend class BatchedDistance;
 
-    // Structure indices
-    std::vector<Integer> sizes;
-    std::vector<Integer> parents;
-    std::vector<std::vector<Integer>> children;
+    // Every per-node index is carved from a single allocation, each array
+    // starting on its own cache line. The node pointers are kept apart, so
+    // that the arena does not depend on the address it is loaded at.
+    static const size_t ALIGNMENT = 64;
 
-    std::vector<Integer> postL_to_lld;
-    std::vector<Integer> postR_to_rld;
-    std::vector<Integer> preL_to_ln;
-    std::vector<Integer> preR_to_ln;
+    const CostModel<Data, Cost>* costModel;
+    LabelDictionary<Data>* labels;
+    const Index treeSize;
+    char* arena;
+    size_t arenaSize;
+    bool ownsArena;
+    std::vector<N*> nodes;
 
-    std::vector<N*> preL_to_node;
-    std::vector<bool> nodeType_L;
-    std::vector<bool> nodeType_R;
+    // Structure indices
+    Index* sizes;
+    Index* parents;
+    // Children in compressed sparse row form: the children of node preL are
+    // children[childrenStart[preL]] to children[childrenStart[preL + 1] - 1].
+    Index* childrenStart;
+    Index* children;
+
+    Index* postL_to_lld;
+    Index* postR_to_rld;
+    Index* preL_to_ln;
+    Index* preR_to_ln;
+
+    N** preL_to_node;
+    int32_t* preL_to_label;
+    uint64_t* preL_to_hash;
+    uint8_t* nodeType_L;
+    uint8_t* nodeType_R;
 
     // Traversal translation indices
-    std::vector<Integer> preL_to_preR;
-    std::vector<Integer> preR_to_preL;
-    std::vector<Integer> preL_to_postL;
-    std::vector<Integer> preL_to_postR;
-    std::vector<Integer> postL_to_preL;
-    std::vector<Integer> postR_to_preL;
+    Index* preL_to_preR;
+    Index* preR_to_preL;
+    Index* preL_to_postL;
+    Index* preL_to_postR;
+    Index* postL_to_preL;
+    Index* postR_to_preL;
 
     // Cost indices
-    std::vector<Integer> preL_to_kr_sum;
-    std::vector<Integer> preL_to_rev_kr_sum;
-    std::vector<Integer> preL_to_desc_sum;
-    std::vector<float> preL_to_sumDelCost;
-    std::vector<float> preL_to_sumInsCost;
+    Sum* preL_to_kr_sum;
+    Sum* preL_to_rev_kr_sum;
+    Sum* preL_to_desc_sum;
+    Cost* preL_to_sumDelCost;
+    Cost* preL_to_sumInsCost;
 
     // Temp variables
-    Integer currentNode;
-    Integer lchl;
-    Integer rchl;
-    Integer sizeTmp;
-    Integer descSizesTmp;
-    Integer krSizesSumTmp;
-    Integer revkrSizesSumTmp;
-    Integer preorderTmp;
-
-    Integer indexNodes(N* node, Integer postorder) {
-        // Initialise variables.
-        Integer currentSize = 0;
-        Integer childrenCount = 0;
-        Integer descSizes = 0;
-        Integer krSizesSum = 0;
-        Integer revkrSizesSum = 0;
-        Integer preorder = preorderTmp;
-        Integer preorderR = 0;
-        Integer currentPreorder = -1;
-
-        // Store the preorder id of the current node to use it after the recursion.
-        preorderTmp++;
-
-        // Loop over children of a node.
-        std::vector<N*> childNodes = node->getChildrenAsVector();
-        for (size_t i = 0; i < childNodes.size(); i++) {
-            childrenCount++;
-            currentPreorder = preorderTmp;
-            parents[currentPreorder] = preorder;
-
-            // Execute method recursively for next child.
-            postorder = indexNodes(childNodes[i], postorder);
-            children[preorder].push_back(currentPreorder);
-
-            currentSize += 1 + sizeTmp;
-            descSizes += descSizesTmp;
-
-            if(childrenCount > 1) {
-                krSizesSum += krSizesSumTmp + sizeTmp + 1;
-            } else {
-                krSizesSum += krSizesSumTmp;
-                nodeType_L[currentPreorder] = true;
-            }
+    Index currentNode;
+    Index lchl;
+    Index rchl;
+
+    template<typename T>
+    static void carve(char* base, size_t &offset, T* &array, size_t count) {
+        array = base ? reinterpret_cast<T*>(base + offset) : nullptr;
+        offset += (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
 
-            if (i < childNodes.size() - 1) {
-                revkrSizesSum += revkrSizesSumTmp + sizeTmp + 1;
-            } else {
-                revkrSizesSum += revkrSizesSumTmp;
-                nodeType_R[currentPreorder] = true;
+    // Assigns the arrays their place in the arena starting at base and returns
+    // the size of the arena. With a null base only the size is computed.
+    size_t layout(char* base) {
+        size_t n = treeSize;
+        size_t offset = 0;
+
+        carve(base, offset, sizes, n);
+        carve(base, offset, parents, n);
+        carve(base, offset, childrenStart, n + 1);
+        carve(base, offset, children, n);
+        carve(base, offset, postL_to_lld, n);
+        carve(base, offset, postR_to_rld, n);
+        carve(base, offset, preL_to_ln, n);
+        carve(base, offset, preR_to_ln, n);
+        carve(base, offset, preL_to_label, labels ? n : 0);
+        carve(base, offset, preL_to_hash, n);
+        carve(base, offset, nodeType_L, n);
+        carve(base, offset, nodeType_R, n);
+        carve(base, offset, preL_to_preR, n);
+        carve(base, offset, preR_to_preL, n);
+        carve(base, offset, preL_to_postL, n);
+        carve(base, offset, preL_to_postR, n);
+        carve(base, offset, postL_to_preL, n);
+        carve(base, offset, postR_to_preL, n);
+        carve(base, offset, preL_to_kr_sum, n);
+        carve(base, offset, preL_to_rev_kr_sum, n);
+        carve(base, offset, preL_to_desc_sum, n);
+        carve(base, offset, preL_to_sumDelCost, n);
+        carve(base, offset, preL_to_sumInsCost, n);
+
+        return offset;
+    }
+
+    // The input trees are Node trees or DAG roots of a TreeStore; these give
+    // both the same interface for indexing.
+    static std::list<N*> &childrenOf(N* node) {
+        return node->getChildren();
+    }
+
+    static const std::vector<DagNode*> &childrenOf(const DagNode* node) {
+        return node->children;
+    }
+
+    N* nodeOf(N* node) {
+        return node;
+    }
+
+    N* nodeOf(const DagNode* node) {
+        return labels->getNode(node->label);
+    }
+
+    int32_t labelOf(N* node) {
+        return labels->intern(node);
+    }
+
+    int32_t labelOf(const DagNode* node) {
+        return node->label;
+    }
+
+    // Enters a node in left-to-right preorder: everything that depends only on
+    // the path from the root and on the preceding nodes.
+    template<class T>
+    void enterNode(T node, Index preorder, Index parent, Index childIndex, Index &childrenCursor, Index &currentLeaf) {
+        Index childrenCount = childrenOf(node).size();
+
+        preL_to_node[preorder] = nodeOf(node);
+        if (labels) {
+            preL_to_label[preorder] = labelOf(node);
+        }
+        // Collects the hashes of the children until the node is left.
+        preL_to_hash[preorder] = hashLabel(preL_to_node[preorder]->getData()->getLabel());
+        parents[preorder] = parent;
+        sizes[preorder] = 1;
+
+        childrenStart[preorder] = childrenCursor;
+        childrenCursor += childrenCount;
+
+        if (parent > -1) {
+            children[childrenStart[parent] + childIndex] = preorder;
+            nodeType_L[preorder] = childIndex == 0;
+            nodeType_R[preorder] = childIndex == childrenStart[parent + 1] - childrenStart[parent] - 1;
+        }
+
+        preL_to_ln[preorder] = currentLeaf;
+        if (childrenCount == 0) {
+            currentLeaf = preorder;
+
+            // Count lchl and rchl.
+            // [TODO] There are no values for parent node.
+            if (parent > -1) {
+                if (nodeType_L[preorder]) {
+                    lchl++;
+                } else if (nodeType_R[preorder]) {
+                    rchl++;
+                }
             }
         }
 
-        postorder++;
+        // Right-to-left postorder is the reversed left-to-right preorder.
+        preL_to_postR[preorder] = treeSize - 1 - preorder;
+        postR_to_preL[treeSize - 1 - preorder] = preorder;
+    }
+
+    // Leaves a node in left-to-right postorder, after all its descendants. The
+    // sums over the subtree are complete here and are pushed to the parent,
+    // whose entries serve as accumulators until the parent is left.
+    void leaveNode(Index preorder, Index postorder) {
+        N* node = preL_to_node[preorder];
+        Index parent = parents[preorder];
+        Index size = sizes[preorder];
 
-        Integer currentDescSizes = descSizes + currentSize + 1;
+        preL_to_postL[preorder] = postorder;
+        postL_to_preL[postorder] = preorder;
+        // Right-to-left preorder is the reversed left-to-right postorder.
+        preL_to_preR[preorder] = treeSize - 1 - postorder;
+        preR_to_preL[treeSize - 1 - postorder] = preorder;
 
-        Integer temp_mul = (currentSize + 1) * (currentSize + 1 + 3);
-        if (__builtin_mul_overflow((currentSize + 1), (currentSize + 1 + 3), &temp_mul)) {
+        Sum descSizes = preL_to_desc_sum[preorder] + size;
+        Sum temp_mul;
+        if (__builtin_mul_overflow((Sum)size, (Sum)(size + 3), &temp_mul)) {
             printf("Overflow in %s::%d\n", __FILE__, __LINE__);
             exit(1);
         }
 
-        preL_to_desc_sum[preorder] = (temp_mul) / 2 - currentDescSizes;
-        preL_to_kr_sum[preorder] = krSizesSum + currentSize + 1;
-        preL_to_rev_kr_sum[preorder] = revkrSizesSum + currentSize + 1;
+        preL_to_desc_sum[preorder] = temp_mul / 2 - descSizes;
+        preL_to_kr_sum[preorder] += size;
+        preL_to_rev_kr_sum[preorder] += size;
 
-        // Store pointer to a node object corresponding to preorder.
-        preL_to_node[preorder] = node;
+        // Sum up costs of deleting and inserting entire subtrees.
+        preL_to_sumDelCost[preorder] += costModel->deleteCost(node);
+        preL_to_sumInsCost[preorder] += costModel->insertCost(node);
 
-        sizes[preorder] = currentSize + 1;
-        preorderR = treeSize - 1 - postorder;
-        preL_to_preR[preorder] = preorderR;
-        preR_to_preL[preorderR] = preorder;
+        preL_to_hash[preorder] = finishHash(preL_to_hash[preorder], size);
 
-        descSizesTmp = currentDescSizes;
-        sizeTmp = currentSize;
-        krSizesSumTmp = krSizesSum;
-        revkrSizesSumTmp = revkrSizesSum;
+        if (parent > -1) {
+            preL_to_hash[parent] = addChildHash(preL_to_hash[parent], preL_to_hash[preorder]);
+            sizes[parent] += size;
+            preL_to_desc_sum[parent] += descSizes;
+            preL_to_kr_sum[parent] += preL_to_kr_sum[preorder] - (nodeType_L[preorder] ? size : 0);
+            preL_to_rev_kr_sum[parent] += preL_to_rev_kr_sum[preorder] - (nodeType_R[preorder] ? size : 0);
+            preL_to_sumDelCost[parent] += preL_to_sumDelCost[preorder];
+            preL_to_sumInsCost[parent] += preL_to_sumInsCost[preorder];
+        }
+    }
 
-        postL_to_preL[postorder] = preorder;
-        preL_to_postL[preorder] = postorder;
-        preL_to_postR[preorder] = treeSize-1-preorder;
-        postR_to_preL[treeSize-1-preorder] = preorder;
+    // First pass: a single depth-first traversal, entering nodes in
+    // left-to-right preorder and leaving them in left-to-right postorder.
+    template<class T>
+    void indexNodes(T root) {
+        typedef decltype(childrenOf(root).begin()) Iterator;
+        struct Frame {
+            T node;
+            Iterator nextChild;
+            Index preorder;
+            Index childIndex;
+        };
+
+        Index preorder = 0;
+        Index postorder = 0;
+        Index childrenCursor = 0;
+        Index currentLeaf = -1;
+
+        std::vector<Frame> stack;
+        enterNode(root, preorder, -1, 0, childrenCursor, currentLeaf);
+        stack.push_back({root, childrenOf(root).begin(), preorder, 0});
+        preorder++;
+
+        while (!stack.empty()) {
+            Frame &top = stack.back();
+
+            if (top.nextChild == childrenOf(top.node).end()) {
+                leaveNode(top.preorder, postorder++);
+                stack.pop_back();
+                continue;
+            }
 
-        return postorder;
+            T child = *top.nextChild;
+            Index childIndex = top.childIndex;
+            Index parent = top.preorder;
+            top.nextChild++;
+            top.childIndex++;
+
+            enterNode(child, preorder, parent, childIndex, childrenCursor, currentLeaf);
+            stack.push_back({child, childrenOf(child).begin(), preorder, 0});
+            preorder++;
+        }
+
+        childrenStart[treeSize] = childrenCursor;
     }
 
+    // Second pass: the indices that need complete translation indices. The loop
+    // variable is at the same time a left-to-right postorder, a right-to-left
+    // postorder and a right-to-left preorder id.
     void postTraversalIndexing() {
-        Integer currentLeaf = -1;
-        Integer nodeForSum = -1;
-        Integer parentForSum = -1;
-
-        for(Integer i = 0; i < treeSize; i++) {
-            preL_to_ln[i] = currentLeaf;
-            if(isLeaf(i)) {
-                currentLeaf = i;
-            }
+        Index currentLeafR = -1;
 
+        for (Index i = 0; i < treeSize; i++) {
             // This block stores leftmost leaf descendants for each node
             // indexed in postorder. Used for mapping computation.
-            // Added by Victor.
-            Integer postl = i; // Assume that the for loop iterates postorder.
-            Integer preorder = postL_to_preL[i];
+            // The first child of a node is the next node in preorder.
+            Index preorder = postL_to_preL[i];
             if (sizes[preorder] == 1) {
-                postL_to_lld[postl] = postl;
+                postL_to_lld[i] = i;
             } else {
-                postL_to_lld[postl] = postL_to_lld[preL_to_postL[children[preorder][0]]];
+                postL_to_lld[i] = postL_to_lld[preL_to_postL[preorder + 1]];
             }
+
             // This block stores rightmost leaf descendants for each node
             // indexed in right-to-left postorder.
-            // [TODO] Use postL_to_lld and postR_to_rld instead of APTED.getLLD
-            //        and APTED.gerRLD methods, remove these method.
-            //        Result: faster lookup of these values.
-            Integer postr = i; // Assume that the for loop iterates reversed postorder.
-            preorder = postR_to_preL[postr];
+            preorder = postR_to_preL[i];
             if (sizes[preorder] == 1) {
-                postR_to_rld[postr] = postr;
+                postR_to_rld[i] = i;
             } else {
-                postR_to_rld[postr] = postR_to_rld[preL_to_postR[children[preorder][children[preorder].size() - 1]]];
-            }
-            // Count lchl and rchl.
-            // [TODO] There are no values for parent node.
-            if (sizes[i] == 1) {
-                Integer parent = parents[i];
-                if (parent > -1) {
-                    if (parent+1 == i) {
-                        lchl++;
-                    } else if (preL_to_preR[parent]+1 == preL_to_preR[i]) {
-                        rchl++;
-                    }
-                }
+                postR_to_rld[i] = postR_to_rld[preL_to_postR[children[childrenStart[preorder + 1] - 1]]];
             }
 
-            // Sum up costs of deleting and inserting entire subtrees.
-            // Reverse the node index. Here, we need traverse nodes bottom-up.
-            nodeForSum = treeSize - i - 1;
-            parentForSum = parents[nodeForSum];
-            // Update myself.
-            preL_to_sumDelCost[nodeForSum] += costModel->deleteCost(preL_to_node[nodeForSum]);
-            preL_to_sumInsCost[nodeForSum] += costModel->insertCost(preL_to_node[nodeForSum]);
-            if (parentForSum > -1) {
-                // Update my parent.
-                preL_to_sumDelCost[parentForSum] += preL_to_sumDelCost[nodeForSum];
-                preL_to_sumInsCost[parentForSum] += preL_to_sumInsCost[nodeForSum];
-            }
-        }
-
-        currentLeaf = -1;
-        // [TODO] Merge with the other loop. Assume different traversal.
-        for(Integer i = 0; i < sizes[0]; i++) {
-            preR_to_ln[i] = currentLeaf;
-            if(isLeaf(preR_to_preL[i])) {
-                currentLeaf = i;
+            preR_to_ln[i] = currentLeafR;
+            if (isLeaf(preR_to_preL[i])) {
+                currentLeafR = i;
             }
         }
     }
 
-public:
-    NodeIndexer(N* inputTree, const CostModel<Data>* costModel)
-    : costModel(costModel)
-    , treeSize(inputTree->getNodeCount()) {
+    void allocateArena() {
         // Initialize tmp variables
         currentNode = 0;
         lchl = 0;
         rchl = 0;
-        sizeTmp = 0;
-        descSizesTmp = 0;
-        krSizesSumTmp = 0;
-        revkrSizesSumTmp = 0;
-        preorderTmp = 0;
 
         // Initialize indices
-        sizes.resize(treeSize, 0);
-        children.resize(treeSize);
-        parents.resize(treeSize, 0); parents[0] = -1; // Root has no parent
-
-        postL_to_lld.resize(treeSize, 0);
-        postR_to_rld.resize(treeSize, 0);
-        preL_to_ln.resize(treeSize, 0);
-        preR_to_ln.resize(treeSize, 0);
-
-        preL_to_node.resize(treeSize, nullptr);
-        nodeType_L.resize(treeSize, false);
-        nodeType_R.resize(treeSize, false);
-
-        preL_to_preR.resize(treeSize, 0);
-        preR_to_preL.resize(treeSize, 0);
-        preL_to_postL.resize(treeSize, 0);
-        preL_to_postR.resize(treeSize, 0);
-        postL_to_preL.resize(treeSize, 0);
-        postR_to_preL.resize(treeSize, 0);
-
-        preL_to_kr_sum.resize(treeSize, 0);
-        preL_to_rev_kr_sum.resize(treeSize, 0);
-        preL_to_desc_sum.resize(treeSize, 0);
-        preL_to_sumDelCost.resize(treeSize, 0.0f);
-        preL_to_sumInsCost.resize(treeSize, 0.0f);
-
-        // Index
-        indexNodes(inputTree, -1);
+        arenaSize = layout(nullptr);
+        void* memory = nullptr;
+        if (posix_memalign(&memory, ALIGNMENT, arenaSize) != 0) {
+            throw std::bad_alloc();
+        }
+        arena = static_cast<char*>(memory);
+        std::memset(arena, 0, arenaSize);
+        layout(arena);
+        preL_to_node = nodes.data();
+    }
+
+public:
+    NodeIndexer(N* inputTree, const CostModel<Data, Cost>* costModel, LabelDictionary<Data>* labels = nullptr)
+    : costModel(costModel)
+    , labels(labels)
+    , treeSize(inputTree->getNodeCount())
+    , ownsArena(true)
+    , nodes(treeSize) {
+        allocateArena();
+        indexNodes(inputTree);
         postTraversalIndexing();
     }
 
-    Integer getSize() {
+    // Indexes the tree of a root of a TreeStore that interns its labels in
+    // the given dictionary. The nodes are the canonical nodes of their labels.
+    NodeIndexer(const DagNode* root, const CostModel<Data, Cost>* costModel, LabelDictionary<Data>* labels)
+    : costModel(costModel)
+    , labels(labels)
+    , treeSize(root->size)
+    , ownsArena(true)
+    , nodes(treeSize) {
+        allocateArena();
+        indexNodes(root);
+        postTraversalIndexing();
+    }
+
+    // A view of the arena of a labeled indexer with the same template
+    // arguments, given with its tree size, lchl and rchl. The arena has to be
+    // aligned to ALIGNMENT and outlive the view; it is neither copied nor
+    // freed. The nodes are the canonical nodes of their labels in the
+    // dictionary the arena was written with, and the cost sums are those of
+    // the cost model it was written with.
+    //
+    // <p>Creating a view takes constant time: the nodes are looked up in the
+    // dictionary only when they are needed (see resolveNodes).
+    NodeIndexer(char* arena, Index treeSize, Index lchl, Index rchl, LabelDictionary<Data>* labels)
+    : costModel(nullptr)
+    , labels(labels)
+    , treeSize(treeSize)
+    , arena(arena)
+    , ownsArena(false) {
+        currentNode = 0;
+        this->lchl = lchl;
+        this->rchl = rchl;
+
+        arenaSize = layout(arena);
+        preL_to_node = nullptr;
+    }
+
+    NodeIndexer(const NodeIndexer &) = delete;
+    NodeIndexer &operator=(const NodeIndexer &) = delete;
+
+    ~NodeIndexer() {
+        if (ownsArena) {
+            free(arena);
+        }
+    }
+
+    // The size of the arena of a tree of treeSize nodes, e.g. to check a
+    // view against the memory it is given.
+    static size_t getArenaSize(Index treeSize, LabelDictionary<Data>* labels) {
+        NodeIndexer sizing(nullptr, treeSize, 0, 0, labels);
+        return sizing.getArenaSize();
+    }
+
+    // Looks up the nodes of a view by their labels, once; the distance
+    // algorithms call it before they use the nodes. Indexers of trees have
+    // their nodes already.
+    void resolveNodes() {
+        if (preL_to_node) {
+            return;
+        }
+
+        nodes.resize(treeSize);
+        for (Index i = 0; i < treeSize; i++) {
+            if (preL_to_label[i] < 0 || preL_to_label[i] >= labels->size()) {
+                printf("Unknown label in %s::%d\n", __FILE__, __LINE__);
+                exit(1);
+            }
+            nodes[i] = labels->getNode(preL_to_label[i]);
+        }
+        preL_to_node = nodes.data();
+    }
+
+    const char* getArena() const {
+        return arena;
+    }
+
+    size_t getArenaSize() const {
+        return arenaSize;
+    }
+
+    Index getLchl() const {
+        return lchl;
+    }
+
+    Index getRchl() const {
+        return rchl;
+    }
+
+    Index getSize() {
         return treeSize;
     }
 
-    Integer preL_to_lld(Integer preL) {
-        return postL_to_preL[postL_to_lld[preL_to_postL[preL]]];
+    // The leftmost leaf is the last node of the subtree in right-to-left
+    // preorder.
+    Index preL_to_lld(Index preL) {
+        return preR_to_preL[preL_to_preR[preL] + sizes[preL] - 1];
     }
 
-    Integer preL_to_rld(Integer preL) {
-        return postR_to_preL[postR_to_rld[preL_to_postR[preL]]];
+    // The rightmost leaf is the last node of the subtree in left-to-right
+    // preorder.
+    Index preL_to_rld(Index preL) {
+        return preL + sizes[preL] - 1;
     }
 
-    Node<Data>* postL_to_node(Integer postL) {
+    Node<Data>* postL_to_node(Index postL) {
         return preL_to_node[postL_to_preL[postL]];
     }
 
-    Node<Data>* postR_to_node(Integer postR) {
+    Node<Data>* postR_to_node(Index postR) {
         return preL_to_node[postR_to_preL[postR]];
     }
 
-    bool isLeaf(Integer nodeId) {
+    const Index* childrenBegin(Index preL) const {
+        return children + childrenStart[preL];
+    }
+
+    const Index* childrenEnd(Index preL) const {
+        return children + childrenStart[preL + 1];
+    }
+
+    bool hasLabels() const {
+        return labels != nullptr;
+    }
+
+    int32_t getLabel(Index preL) const {
+        return preL_to_label[preL];
+    }
+
+    uint64_t getHash(Index preL) const {
+        return preL_to_hash[preL];
+    }
+
+    Index getSubtreeSize(Index preL) const {
+        return sizes[preL];
+    }
+
+    bool isLeaf(Index nodeId) {
         return sizes[nodeId] == 1;
     }
 
-    Integer getCurrentNode() const {
+    Index getCurrentNode() const {
         return currentNode;
     }
 
-    void setCurrentNode(Integer preorder) {
+    void setCurrentNode(Index preorder) {
         currentNode = preorder;
     }
 
     void dump() {
         std::cerr << std::string(80, '-') << std::endl;
-        std::cerr << "sizes: "              << arrayToString(sizes)              << std::endl;
-        std::cerr << "preL_to_preR: "       << arrayToString(preL_to_preR)       << std::endl;
-        std::cerr << "preR_to_preL: "       << arrayToString(preR_to_preL)       << std::endl;
-        std::cerr << "preL_to_postL: "      << arrayToString(preL_to_postL)      << std::endl;
-        std::cerr << "postL_to_preL: "      << arrayToString(postL_to_preL)      << std::endl;
-        std::cerr << "preL_to_postR: "      << arrayToString(preL_to_postR)      << std::endl;
-        std::cerr << "postR_to_preL: "      << arrayToString(postR_to_preL)      << std::endl;
-        std::cerr << "postL_to_lld: "       << arrayToString(postL_to_lld)       << std::endl;
-        std::cerr << "postR_to_rld: "       << arrayToString(postR_to_rld)       << std::endl;
-        std::cerr << "preL_to_node: "       << arrayToString(preL_to_node)       << std::endl;
-        std::cerr << "preL_to_ln: "         << arrayToString(preL_to_ln)         << std::endl;
-        std::cerr << "preR_to_ln: "         << arrayToString(preR_to_ln)         << std::endl;
-        std::cerr << "preL_to_kr_sum: "     << arrayToString(preL_to_kr_sum)     << std::endl;
-        std::cerr << "preL_to_rev_kr_sum: " << arrayToString(preL_to_rev_kr_sum) << std::endl;
-        std::cerr << "preL_to_desc_sum: "   << arrayToString(preL_to_desc_sum)   << std::endl;
-        std::cerr << "preL_to_sumDelCost: " << arrayToString(preL_to_sumDelCost) << std::endl;
-        std::cerr << "preL_to_sumInsCost: " << arrayToString(preL_to_sumInsCost) << std::endl;
-        std::cerr << "children: "           << arrayToString(children)           << std::endl;
-        std::cerr << "nodeType_L: "         << arrayToString(nodeType_L)         << std::endl;
-        std::cerr << "nodeType_R: "         << arrayToString(nodeType_R)         << std::endl;
-        std::cerr << "parents: "            << arrayToString(parents)            << std::endl;
+        std::cerr << "sizes: "              << toString(sizes)                   << std::endl;
+        std::cerr << "preL_to_hash: "       << toString(preL_to_hash)            << std::endl;
+        std::cerr << "preL_to_preR: "       << toString(preL_to_preR)            << std::endl;
+        std::cerr << "preR_to_preL: "       << toString(preR_to_preL)            << std::endl;
+        std::cerr << "preL_to_postL: "      << toString(preL_to_postL)           << std::endl;
+        std::cerr << "postL_to_preL: "      << toString(postL_to_preL)           << std::endl;
+        std::cerr << "preL_to_postR: "      << toString(preL_to_postR)           << std::endl;
+        std::cerr << "postR_to_preL: "      << toString(postR_to_preL)           << std::endl;
+        std::cerr << "postL_to_lld: "       << toString(postL_to_lld)            << std::endl;
+        std::cerr << "postR_to_rld: "       << toString(postR_to_rld)            << std::endl;
+        std::cerr << "preL_to_node: "       << toString(preL_to_node)            << std::endl;
+        if (labels) {
+            std::cerr << "preL_to_label: "  << toString(preL_to_label)           << std::endl;
+        }
+        std::cerr << "preL_to_ln: "         << toString(preL_to_ln)              << std::endl;
+        std::cerr << "preR_to_ln: "         << toString(preR_to_ln)              << std::endl;
+        std::cerr << "preL_to_kr_sum: "     << toString(preL_to_kr_sum)          << std::endl;
+        std::cerr << "preL_to_rev_kr_sum: " << toString(preL_to_rev_kr_sum)      << std::endl;
+        std::cerr << "preL_to_desc_sum: "   << toString(preL_to_desc_sum)        << std::endl;
+        std::cerr << "preL_to_sumDelCost: " << toString(preL_to_sumDelCost)      << std::endl;
+        std::cerr << "preL_to_sumInsCost: " << toString(preL_to_sumInsCost)      << std::endl;
+        std::cerr << "childrenStart: "      << toString(childrenStart, 1)        << std::endl;
+        std::cerr << "children: "           << toString(children, -1)            << std::endl;
+        std::cerr << "nodeType_L: "         << toString(nodeType_L)              << std::endl;
+        std::cerr << "nodeType_R: "         << toString(nodeType_R)              << std::endl;
+        std::cerr << "parents: "            << toString(parents)                 << std::endl;
         std::cerr << std::string(80, '-') << std::endl;
     }
+
+private:
+    template<typename T>
+    std::string toString(T* array, Index extra = 0) {
+        std::vector<T> copy(array, array + treeSize + extra);
+        return arrayToString(copy);
+    }
+
+    std::string toString(uint8_t* array) {
+        std::vector<bool> copy(array, array + treeSize);
+        return arrayToString(copy);
+    }
 };
 
 }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Structural Hashes
+//------------------------------------------------------------------------------
+
+// The structural (Merkle) hash of a subtree starts from the hash of its root
+// label, takes in the finished hashes of the children in order and is
+// finished with the subtree size. NodeIndexer and TreeStore hash the same
+// way, so their hashes of a subtree agree.
+
+// FNV-1a, so that hashes stored in files agree across processes.
+inline uint64_t hashLabel(const std::string &label) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : label) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// The splitmix64 finalizer, so that every bit of a child hash affects its
+// parent's.
+inline uint64_t mixHash(uint64_t hash) {
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+// The rotation makes the hash depend on the order of the children.
+inline uint64_t addChildHash(uint64_t hash, uint64_t child) {
+    return (hash << 7 | hash >> 57) ^ child;
+}
+
+// The size tells where the children end.
+inline uint64_t finishHash(uint64_t hash, int64_t size) {
+    return mixHash(hash ^ (uint64_t)size);
+}
+
+} // namespace capted
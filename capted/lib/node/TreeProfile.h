@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <cstdint>
+#include "Node.h"
+#include "LabelDictionary.h"
+#include "util/int.h"
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Tree Profile
+//------------------------------------------------------------------------------
+
+/**
+ * The interned labels of a tree as a bag and in left-to-right preorder and
+ * postorder. These are the inputs of the lower bounds on the unit cost tree
+ * edit distance in distance/LowerBound.h; profiles of trees that are compared
+ * have to share a label dictionary.
+ *
+ * <p>A profile either owns its sequences or is a view of sequences stored
+ * elsewhere, e.g. in a memory-mapped corpus index.
+ *
+ * @param <D> type of node data.
+ */
+template<class Data>
+class TreeProfile {
+private:
+    typedef Node<Data> N;
+
+    struct Frame {
+        N* node;
+        typename std::list<N*>::iterator nextChild;
+    };
+
+    // Bag, preorder and postorder of an owning profile, one after another.
+    std::vector<int32_t> storage;
+
+    void pointToStorage() {
+        labelBag = storage.data();
+        preorder = storage.data() + size;
+        postorder = storage.data() + 2 * size;
+    }
+
+public:
+    Integer size;
+    // Sorted label ids.
+    const int32_t* labelBag;
+    const int32_t* preorder;
+    const int32_t* postorder;
+
+    TreeProfile() : size(0), labelBag(nullptr), preorder(nullptr), postorder(nullptr) {
+        // nop
+    }
+
+    TreeProfile(Integer size, const int32_t* labelBag, const int32_t* preorder, const int32_t* postorder)
+    : size(size)
+    , labelBag(labelBag)
+    , preorder(preorder)
+    , postorder(postorder) {
+        // nop
+    }
+
+    TreeProfile(N* root, LabelDictionary<Data> &labels) {
+        std::vector<int32_t> pre;
+        std::vector<int32_t> post;
+        std::vector<Frame> stack;
+        pre.push_back(labels.intern(root));
+        stack.push_back({root, root->getChildren().begin()});
+
+        while (!stack.empty()) {
+            Frame &top = stack.back();
+
+            if (top.nextChild == top.node->getChildren().end()) {
+                post.push_back(labels.intern(top.node));
+                stack.pop_back();
+                continue;
+            }
+
+            N* child = *top.nextChild;
+            top.nextChild++;
+            pre.push_back(labels.intern(child));
+            stack.push_back({child, child->getChildren().begin()});
+        }
+
+        size = pre.size();
+        storage = pre;
+        std::sort(storage.begin(), storage.end());
+        storage.insert(storage.end(), pre.begin(), pre.end());
+        storage.insert(storage.end(), post.begin(), post.end());
+        pointToStorage();
+    }
+
+    TreeProfile(const TreeProfile &other)
+    : storage(other.storage)
+    , size(other.size)
+    , labelBag(other.labelBag)
+    , preorder(other.preorder)
+    , postorder(other.postorder) {
+        if (!storage.empty()) {
+            pointToStorage();
+        }
+    }
+
+    TreeProfile &operator=(const TreeProfile &other) {
+        storage = other.storage;
+        size = other.size;
+        labelBag = other.labelBag;
+        preorder = other.preorder;
+        postorder = other.postorder;
+        if (!storage.empty()) {
+            pointToStorage();
+        }
+        return *this;
+    }
+};
+
+} // namespace capted
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include "Node.h"
+#include "LabelDictionary.h"
+#include "TreeHash.h"
+#include "util/int.h"
+
+namespace capted {
+
+//------------------------------------------------------------------------------
+// Tree Store
+//------------------------------------------------------------------------------
+
+// A node of the DAG of a TreeStore: an interned label and interned children,
+// with the size and structural hash of the subtree it stands for.
+struct DagNode {
+    int32_t label;
+    // One per occurrence as a child of another node, plus the references
+    // handed out by the store.
+    uint32_t references;
+    Integer size;
+    uint64_t hash;
+    std::vector<DagNode*> children;
+};
+
+/**
+ * Stores trees as one DAG in which identical subtrees are a single node
+ * (hash-consing), so that subtrees that recur across a corpus are kept once.
+ * A DAG node takes a few dozen bytes and no label string, and a subtree that
+ * occurs in many trees costs its nodes once, so large corpora take a fraction
+ * of the memory of their Node trees.
+ *
+ * <p>Nodes are reference counted. Adding a tree hands out one reference to
+ * its root, which has to be given back with release; nodes no longer part of
+ * any tree are freed then. A NodeIndexer indexes the tree of a root like a
+ * Node tree, with the canonical nodes of the labels as its nodes (see the DAG
+ * constructor of NodeIndexer).
+ *
+ * <p>Labels are interned in the dictionary given to the store. The store is
+ * not thread-safe.
+ *
+ * @param <D> type of node data.
+ */
+template<class Data>
+class TreeStore {
+private:
+    typedef Node<Data> N;
+
+    struct Frame {
+        N* node;
+        typename std::list<N*>::iterator nextChild;
+        std::vector<DagNode*> children;
+    };
+
+    LabelDictionary<Data>* labels;
+    std::unordered_multimap<uint64_t, DagNode*> nodes;
+    std::vector<uint64_t> labelHashes;
+    int64_t treeNodes;
+
+    uint64_t labelHash(int32_t label) {
+        while ((int32_t)labelHashes.size() <= label) {
+            labelHashes.push_back(hashLabel(labels->getLabel(labelHashes.size())));
+        }
+        return labelHashes[label];
+    }
+
+    // Returns the node with the label and children, with one more reference.
+    // The references to the children move to the node.
+    DagNode* intern(int32_t label, std::vector<DagNode*> &children) {
+        uint64_t hash = labelHash(label);
+        Integer size = 1;
+        for (DagNode* child : children) {
+            hash = addChildHash(hash, child->hash);
+            size += child->size;
+        }
+        hash = finishHash(hash, size);
+
+        auto range = nodes.equal_range(hash);
+        for (auto it = range.first; it != range.second; it++) {
+            DagNode* node = it->second;
+            if (node->label == label && node->children == children) {
+                // The node holds references to the children already.
+                for (DagNode* child : children) {
+                    releaseNode(child);
+                }
+                node->references++;
+                return node;
+            }
+        }
+
+        DagNode* node = new DagNode{label, 1, size, hash, std::move(children)};
+        nodes.emplace(hash, node);
+        return node;
+    }
+
+    void releaseNode(DagNode* node) {
+        std::vector<DagNode*> pending = {node};
+
+        while (!pending.empty()) {
+            DagNode* current = pending.back();
+            pending.pop_back();
+            if (--current->references > 0) {
+                continue;
+            }
+
+            auto range = nodes.equal_range(current->hash);
+            for (auto it = range.first; it != range.second; it++) {
+                if (it->second == current) {
+                    nodes.erase(it);
+                    break;
+                }
+            }
+            pending.insert(pending.end(), current->children.begin(), current->children.end());
+            delete current;
+        }
+    }
+
+public:
+    TreeStore(LabelDictionary<Data>* labels) : labels(labels), treeNodes(0) {
+        // nop
+    }
+
+    TreeStore(const TreeStore &) = delete;
+    TreeStore &operator=(const TreeStore &) = delete;
+
+    ~TreeStore() {
+        for (const std::pair<const uint64_t, DagNode*> &entry : nodes) {
+            delete entry.second;
+        }
+    }
+
+    // Adds a copy of the tree and returns its root. The tree itself is not
+    // kept and can be deleted.
+    DagNode* add(N* tree) {
+        DagNode* root = nullptr;
+        std::vector<Frame> stack;
+        stack.push_back({tree, tree->getChildren().begin(), {}});
+
+        // Children are interned before their parents.
+        while (!stack.empty()) {
+            Frame &top = stack.back();
+
+            if (top.nextChild != top.node->getChildren().end()) {
+                N* child = *top.nextChild;
+                top.nextChild++;
+                stack.push_back({child, child->getChildren().begin(), {}});
+                continue;
+            }
+
+            DagNode* node = intern(labels->intern(top.node), top.children);
+            stack.pop_back();
+            if (stack.empty()) {
+                root = node;
+            } else {
+                stack.back().children.push_back(node);
+            }
+        }
+
+        treeNodes += root->size;
+        return root;
+    }
+
+    // Hands out another reference to a root.
+    void retain(DagNode* root) {
+        root->references++;
+        treeNodes += root->size;
+    }
+
+    void release(DagNode* root) {
+        treeNodes -= root->size;
+        releaseNode(root);
+    }
+
+    LabelDictionary<Data>* getLabels() const {
+        return labels;
+    }
+
+    // The number of DAG nodes.
+    int64_t size() const {
+        return nodes.size();
+    }
+
+    // The number of nodes of the trees held, counting shared nodes once per
+    // occurrence.
+    int64_t getTreeNodes() const {
+        return treeNodes;
+    }
+};
+
+} // namespace capted
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace capted{
 
 #ifdef CAPTED_LARGE_TREES
@@ -8,4 +10,16 @@ typedef int64_t Integer;
 typedef int32_t Integer;
 #endif
 
+// Type of the per-node sums over subtree sizes (keyroot and descendant sums),
+// which grow quadratically with the size of the tree.
+template<typename Index>
+struct WideInteger {
+    typedef int64_t type;
+};
+
+template<>
+struct WideInteger<int16_t> {
+    typedef int32_t type;
+};
+
 }
@@ -11,67 +11,270 @@ using std::string;
 using json = nlohmann::json;
 
 //------------------------------------------------------------------------------
-// Main
+// Test cases
 //------------------------------------------------------------------------------
 
-void testEditDistance() {
-    std::ifstream testFile("./tests/correctness_test_cases.json");
+struct TestCase {
+    int id;
+    float d;
+    string t1;
+    string t2;
+};
+
+std::vector<TestCase> loadTestCases(const char* path = "./tests/correctness_test_cases.json") {
+    std::ifstream testFile(path);
     json testCases;
     testFile >> testCases;
 
-    std::vector<int> testsToRun = {};
-    std::vector<int> testsToSkip = {}; // {64, 71} are really slow without APTED algorithm
-
+    std::vector<TestCase> loaded;
     for (json test : testCases) {
-        int id = test["testID"];
-        float realDist = test["d"];
-        string t1 = test["t1"];
-        string t2 = test["t2"];
-
-        if (std::find(testsToSkip.begin(), testsToSkip.end(), id) != testsToSkip.end()) {
-            // Skip slow tests
-            continue;
-        }
-
-        if (testsToRun.size() > 0 && std::find(testsToRun.begin(), testsToRun.end(), id) == testsToRun.end()) {
-            // Run specific tests?
-            continue;
-        }
+        loaded.push_back({test["testID"], test.value("d", -1.0f), test["t1"], test["t2"]});
+    }
+    return loaded;
+}
 
-        StringCostModel costModel;
-        Apted<StringNodeData> algorithm(&costModel);
-        BracketStringInputParser p1(t1);
-        BracketStringInputParser p2(t2);
+// Runs check on the parsed trees of every test case and prints whether it
+// passed.
+template<class Check>
+void forEachTestCase(Check check) {
+    for (const TestCase& test : loadTestCases()) {
+        BracketStringInputParser p1(test.t1);
+        BracketStringInputParser p2(test.t2);
         Node<StringNodeData>* n1 = p1.getRoot();
         Node<StringNodeData>* n2 = p2.getRoot();
 
-        float compDist = algorithm.computeEditDistance(n1, n2);
-        cout << std::setw(3) << id << " " << (realDist == compDist ? "✓" : "FAIL") << endl;
+        bool passed = check(test, n1, n2);
+        cout << std::setw(3) << test.id << " " << (passed ? "✓" : "FAIL") << endl;
 
         delete n1;
         delete n2;
     }
 }
 
-void testLargeEditDistance() {
-    std::ifstream testFile("./tests/large_test_case.json");
-    json testCases;
-    testFile >> testCases;
+//------------------------------------------------------------------------------
+// Main
+//------------------------------------------------------------------------------
 
-    for (json test : testCases) {
-        int id = test["testID"];
-        string t1 = test["t1"];
-        string t2 = test["t2"];
+void testEditDistance() {
+    forEachTestCase([](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        StringCostModel costModel;
+        Apted<StringNodeData> algorithm(&costModel);
+        return test.d == algorithm.computeEditDistance(n1, n2);
+    });
+}
+
+template<class Cost, class Index>
+void testIntegerEditDistance() {
+    forEachTestCase([](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        BasicStringCostModel<Cost> costModel;
+        Apted<StringNodeData, Cost, Index> algorithm(&costModel);
+        algorithm.setSmallTreeRouting(false);
+        return (Cost)test.d == algorithm.computeEditDistance(n1, n2);
+    });
+}
+
+// The lower bounds must not exceed the distance. With the distance as budget,
+// the bounded sequence distance must not report an excess.
+void testLowerBounds() {
+    forEachTestCase([](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        Integer realDist = test.d;
+        LabelDictionary<StringNodeData> labels;
+        TreeProfile<StringNodeData> profile1(n1, labels);
+        TreeProfile<StringNodeData> profile2(n2, labels);
+        return labelBagLowerBound(profile1, profile2) <= realDist
+            && traversalLowerBound(profile1, profile2, realDist) <= realDist;
+    });
+}
 
+// The mapping has to cover every node once and cost the distance.
+void testEditMapping() {
+    forEachTestCase([](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        StringCostModel costModel;
+        Apted<StringNodeData> algorithm(&costModel);
+        algorithm.computeEditDistance(n1, n2);
+        std::vector<IntPair> mapping = algorithm.computeEditMapping();
+
+        std::vector<int> seen1(n1->getNodeCount(), 0);
+        std::vector<int> seen2(n2->getNodeCount(), 0);
+        for (IntPair e : mapping) {
+            if (e.first > -1) {
+                seen1[e.first]++;
+            }
+            if (e.second > -1) {
+                seen2[e.second]++;
+            }
+        }
+        bool complete = std::count(seen1.begin(), seen1.end(), 1) == (int)seen1.size()
+                     && std::count(seen2.begin(), seen2.end(), 1) == (int)seen2.size();
+        return complete && test.d == algorithm.mappingCost(mapping);
+    });
+}
+
+// A tree and a copy of it have equal hashes and distance 0, with a mapping
+// that still covers every node; trees at a positive distance have different
+// hashes.
+void testIdenticalTrees() {
+    forEachTestCase([](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        StringCostModel costModel;
+        Apted<StringNodeData> algorithm(&costModel);
+        algorithm.setSmallTreeRouting(false);
+        BracketStringInputParser copy(test.t1);
+        Node<StringNodeData>* c1 = copy.getRoot();
+
+        float compDist = algorithm.computeEditDistance(n1, c1);
+        std::vector<IntPair> mapping = algorithm.computeEditMapping();
+        bool complete = (Integer)mapping.size() == n1->getNodeCount() && algorithm.mappingCost(mapping) == 0;
+
+        NodeIndexer<StringNodeData> i1(n1, &costModel);
+        NodeIndexer<StringNodeData> i2(n2, &costModel);
+        bool hashes = (test.d == 0) == (i1.getHash(0) == i2.getHash(0));
+
+        delete c1;
+        return compDist == 0 && complete && hashes;
+    });
+}
+
+// All trees go into one store; the distances of the indexed DAG roots, and of
+// the small ones without indexing, are checked, and the store has to be empty
+// once every root is released.
+void testTreeStore() {
+    typedef NodeIndexer<StringNodeData> Indexer;
+    StringCostModel costModel;
+    LabelDictionary<StringNodeData> labels;
+    TreeStore<StringNodeData> store(&labels);
+    std::vector<DagNode*> roots;
+
+    forEachTestCase([&](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        DagNode* r1 = store.add(n1);
+        DagNode* r2 = store.add(n2);
+        roots.push_back(r1);
+        roots.push_back(r2);
+
+        Apted<StringNodeData> algorithm(&costModel);
+        Indexer tree1(n1, &costModel);
+        Indexer dag1(r1, &costModel, &labels);
+        Indexer dag2(r2, &costModel, &labels);
+        bool hashes = dag1.getHash(0) == tree1.getHash(0) && dag1.getHash(0) == r1->hash;
+
+        float compDist = algorithm.computeEditDistance(&dag1, &dag2);
+
+        // Small pairs of a DAG root and a tree are flattened directly.
+        float smallDist = test.d;
+        SmallTreeDistance<StringNodeData, float, SMALL_TREE_SIZE>::compute(&costModel, r1, n2, &labels, smallDist);
+        return test.d == compDist && test.d == smallDist && hashes;
+    });
+
+    bool shared = store.size() < store.getTreeNodes();
+    for (DagNode* root : roots) {
+        store.release(root);
+    }
+    cout << "store " << (shared && store.size() == 0 && store.getTreeNodes() == 0 ? "✓" : "FAIL") << endl;
+}
+
+// The arenas of labeled indexers are copied and compared through views, which
+// look up their nodes only once they are compared.
+void testIndexerViews() {
+    typedef NodeIndexer<StringNodeData> Indexer;
+    StringCostModel costModel;
+    LabelDictionary<StringNodeData> labels;
+
+    forEachTestCase([&](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        Indexer tree1(n1, &costModel, &labels);
+        Indexer tree2(n2, &costModel, &labels);
+
+        void* arena1 = nullptr;
+        void* arena2 = nullptr;
+        bool sized = posix_memalign(&arena1, 64, tree1.getArenaSize()) == 0
+                && posix_memalign(&arena2, 64, tree2.getArenaSize()) == 0
+                && Indexer::getArenaSize(tree1.getSize(), &labels) == tree1.getArenaSize()
+                && Indexer::getArenaSize(tree2.getSize(), &labels) == tree2.getArenaSize();
+        std::memcpy(arena1, tree1.getArena(), tree1.getArenaSize());
+        std::memcpy(arena2, tree2.getArena(), tree2.getArenaSize());
+
+        float compDist;
+        {
+            Indexer view1(static_cast<char*>(arena1), tree1.getSize(), tree1.getLchl(), tree1.getRchl(), &labels);
+            Indexer view2(static_cast<char*>(arena2), tree2.getSize(), tree2.getLchl(), tree2.getRchl(), &labels);
+            Apted<StringNodeData> algorithm(&costModel);
+            compDist = algorithm.computeEditDistance(&view1, &view2);
+        }
+
+        free(arena1);
+        free(arena2);
+        return test.d == compDist && sized;
+    });
+}
+
+// Every pair is computed twice with a shared cache; the second time has to be
+// a hit with the same distance. A full shard evicts its least recently used
+// distance.
+void testDistanceCache() {
+    StringCostModel costModel;
+    DistanceCache cache(1 << 16);
+    uint64_t pairs = 0;
+
+    forEachTestCase([&](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>* n2) {
+        float compDists[2];
+        for (float &compDist : compDists) {
+            Apted<StringNodeData> algorithm(&costModel);
+            algorithm.setSmallTreeRouting(false);
+            algorithm.setDistanceCache(&cache, 1);
+            compDist = algorithm.computeEditDistance(n1, n2);
+        }
+        pairs++;
+        return test.d == compDists[0] && test.d == compDists[1];
+    });
+
+    DistanceCache small(1, 1);
+    double distance;
+    small.insert(1, 5, 2, 5, 0, 3);
+    small.insert(2, 5, 1, 5, 0, 4);
+    bool evicted = !small.find(1, 5, 2, 5, 0, distance) && small.find(2, 5, 1, 5, 0, distance) && distance == 4;
+    // Equal hashes of trees of other sizes are a collision, not a hit.
+    bool sized = !small.find(2, 6, 1, 5, 0, distance);
+    cout << "cache " << (cache.getHits() >= pairs && evicted && sized ? "✓" : "FAIL") << endl;
+}
+
+// Every query tree is compared with the right-hand trees of all tests at once;
+// the distance to its own test's tree is checked.
+void testBatchedEditDistance() {
+    typedef NodeIndexer<StringNodeData> Indexer;
+    StringCostModel costModel;
+    LabelDictionary<StringNodeData> labels;
+    std::vector<Node<StringNodeData>*> trees;
+    std::vector<Indexer*> candidates;
+
+    for (const TestCase& test : loadTestCases()) {
+        BracketStringInputParser p2(test.t2);
+        trees.push_back(p2.getRoot());
+        candidates.push_back(new Indexer(trees.back(), &costModel, &labels));
+    }
+
+    BatchedDistance<StringNodeData> algorithm;
+    Integer index = 0;
+    forEachTestCase([&](const TestCase& test, Node<StringNodeData>* n1, Node<StringNodeData>*) {
+        Indexer query(n1, &costModel, &labels);
+        std::vector<Integer> compDists = algorithm.computeEditDistances(&query, candidates);
+        return test.d == compDists[index++];
+    });
+
+    for (Integer i = 0; i < (Integer)trees.size(); i++) {
+        delete candidates[i];
+        delete trees[i];
+    }
+}
+
+void testLargeEditDistance() {
+    for (const TestCase& test : loadTestCases("./tests/large_test_case.json")) {
         StringCostModel costModel;
         Apted<StringNodeData> algorithm(&costModel);
-        BracketStringInputParser p1(t1);
-        BracketStringInputParser p2(t2);
+        BracketStringInputParser p1(test.t1);
+        BracketStringInputParser p2(test.t2);
         Node<StringNodeData>* n1 = p1.getRoot();
         Node<StringNodeData>* n2 = p2.getRoot();
 
         float compDist = algorithm.computeEditDistance(n1, n2);
-        cout << std::setw(3) << id << " " << compDist << endl;
+        cout << std::setw(3) << test.id << " " << compDist << endl;
 
         delete n1;
         delete n2;
@@ -83,5 +286,15 @@ int main(int argc, char const *argv[]) {
     testLargeEditDistance();
     #else
     testEditDistance();
+    testIntegerEditDistance<int32_t, int32_t>();
+    testIntegerEditDistance<int16_t, int16_t>();
+    testIntegerEditDistance<int64_t, int64_t>();
+    testBatchedEditDistance();
+    testEditMapping();
+    testLowerBounds();
+    testIdenticalTrees();
+    testTreeStore();
+    testIndexerViews();
+    testDistanceCache();
     #endif
 }
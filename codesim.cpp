@@ -1,15 +1,90 @@
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
 #include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include <clang-c/Index.h>
 #include "Capted.h"
+#include "Codesim.h"
+#include "AstCache.h"
+#include "CorpusIndex.h"
+#include "PreambleCache.h"
+#include "ParsePool.h"
+#include "Assignment.h"
+#include "Canonicalizer.h"
+#include "Archive.h"
+#include "Join.h"
+#include "AllPairs.h"
+#include "Revisions.h"
+#include "Watch.h"
+#include "Server.h"
 
 using namespace capted;
 
 bool verbose = false;
 
+// trees of files parsed before, if enabled
+AstCache *astCache = nullptr;
+
+// translation units to reparse files with the includes of earlier ones. Each
+// parsing thread has its own, with its own libclang index.
+thread_local std::unique_ptr<PreambleCache> preambleCache;
+
+// threads that parse the files of a corpus, and the libclang global options
+// of their indexes
+long parseThreads = ParsePool::defaultThreads();
+unsigned clangGlobalOptions = CXGlobalOpt_None;
+
+// keeps the output of parsing threads apart
+std::mutex outputMutex;
+
+// distances of pairs of trees compared before, by their hashes, if enabled.
+// All distances of codesim come from BasicStringCostModel, the one cost model
+// in the cache.
+DistanceCache *distanceCache = nullptr;
+const uint32_t unitCostModelId = 1;
+
+// parse each file on its own, without expanding includes. Declarations from
+// headers are unknown then, so some expressions that use them come out as
+// different cursor kinds.
+bool fastParse = false;
+
+// removes nodes of little structure from every tree built, if enabled
+Canonicalizer *canonicalizer = nullptr;
+
+// compare files function by function, see functionSimilarity. The files of
+// corpora are kept as trees then.
+bool functionLevel = false;
+
+// pass args to clang to control its behavior
+// to help clang find header files, e.g. stddef.h, put clang's builtin headers in.
+// in latest versions, doesn't need this anymore. Only care for clang-6.0
+constexpr const char* defaultArguments[] = {
+  "-std=c++11",
+  "-I/usr/lib/llvm-6.0/lib/clang/6.0.0/include"
+};
+
+// what treeBuilder passes down to the children of a cursor
+struct TreeBuilderContext
+{
+	Node<StringNodeData> *parent;
+	std::vector<NodeSource> *sources;
+};
+
 // CXStrings need to be disprosed
 // For convinience, we convert them to std::string.
 std::string getCursorKindName(CXCursorKind cursorKind)
@@ -52,6 +127,17 @@ CXChildVisitResult visitor(CXCursor cursor, CXCursor /* parent */, CXClientData
 	return CXChildVisit_Continue;
 }
 
+NodeSource getNodeSource(CXCursor cursor, const std::string &kind)
+{
+	NodeSource source;
+	source.kind = kind;
+
+	CXSourceRange extent = clang_getCursorExtent(cursor);
+	clang_getSpellingLocation(clang_getRangeStart(extent), nullptr, &source.startLine, &source.startColumn, nullptr);
+	clang_getSpellingLocation(clang_getRangeEnd(extent), nullptr, &source.endLine, &source.endColumn, nullptr);
+	return source;
+}
+
 CXChildVisitResult treeBuilder(CXCursor cursor, CXCursor /* parent */, CXClientData clientData)
 {
 	CXSourceLocation location = clang_getCursorLocation(cursor);
@@ -60,49 +146,126 @@ CXChildVisitResult treeBuilder(CXCursor cursor, CXCursor /* parent */, CXClientD
 
 	// create a Node for current AST structure
 	CXCursorKind cursorKind = clang_getCursorKind(cursor);
-	auto *current = new Node<StringNodeData>(new StringNodeData(getCursorKindName(cursorKind)));
+	std::string kind = getCursorKindName(cursorKind);
+	auto *current = new Node<StringNodeData>(new StringNodeData(kind));
 
 	// link it to the main tree
-	Node<StringNodeData> *parent = *(reinterpret_cast<Node<StringNodeData> **>(clientData));
-	parent->addChild(current);
+	TreeBuilderContext *context = reinterpret_cast<TreeBuilderContext *>(clientData);
+	context->parent->addChild(current);
+
+	// nodes are visited in preorder, the order of capted's node ids
+	if (context->sources)
+		context->sources->push_back(getNodeSource(cursor, kind));
 
 	// continue to visit its children nodes.
+	TreeBuilderContext childContext = {current, context->sources};
 	clang_visitChildren(cursor,
 						treeBuilder,
-						&current);
+						&childContext);
 
 	return CXChildVisit_Continue;
 }
 
-Node<StringNodeData> *buildTree(std::string& filename)
+std::string readFile(const std::string &filename)
 {
-	int displayDiagnostics = 0;
-	if (verbose) {
-		std::cerr << "Parsing " << filename << "...\n";
-		displayDiagnostics = 1;
+	std::ifstream in(filename, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// the sources of the archives given as corpora, by archive/member; filled by
+// listCorpus before anything is parsed and only read afterwards
+std::unordered_map<std::string, std::string> archiveSources;
+
+// the contents of a source file, or of an archive member listed before
+std::string readSource(const std::string &filename)
+{
+	auto member = archiveSources.find(filename);
+	if (member != archiveSources.end())
+		return member->second;
+	return readFile(filename);
+}
+
+// everything besides the file contents that the tree of a file depends on
+std::string getParseSignature()
+{
+	CXString version = clang_getClangVersion();
+	std::string signature = clang_getCString(version);
+	clang_disposeString(version);
+
+	for (const char *argument : defaultArguments)
+	{
+		signature += '\0';
+		signature += argument;
 	}
+	if (fastParse)
+		signature += std::string(1, '\0') + "fast";
+	if (canonicalizer)
+		signature += std::string(1, '\0') + canonicalizer->getSignature();
+	return signature;
+}
 
-	CXIndex index = clang_createIndex(0, displayDiagnostics);
-	CXTranslationUnit translationUnit;
+// canonicalizes a tree just built, along with the sources of its nodes
+void canonicalizeTree(Node<StringNodeData> *root, std::vector<NodeSource> *sources)
+{
+	if (!sources)
+	{
+		canonicalizer->canonicalize(root);
+		return;
+	}
 
-	// pass args to clang to control its behavior
-	// to help clang find header files, e.g. stddef.h, put clang's builtin headers in.
-	// in latest versions, doesn't need this anymore. Only care for clang-6.0
-	constexpr const char* defaultArguments[] = {
-	  "-std=c++11",
-	  "-I/usr/lib/llvm-6.0/lib/clang/6.0.0/include"
-	};
-	translationUnit = clang_parseTranslationUnit(index,
-												 filename.c_str(),
-												 defaultArguments,
-												 std::extent<decltype(defaultArguments)>::value,
-												 nullptr, 0,
-												 CXTranslationUnit_None);
+	std::vector<bool> kept;
+	canonicalizer->canonicalize(root, &kept);
+	size_t first = sources->size() - kept.size();
+	size_t next = first;
+	for (size_t i = 0; i < kept.size(); i++)
+	{
+		if (kept[i])
+			(*sources)[next++] = (*sources)[first + i];
+	}
+	sources->resize(next);
+}
+
+// Parses contents as the file filename, which need not exist. cacheKey
+// identifies the contents and their parseContext in the AST cache. If sources is given, it receives
+// the kind and extent of every node in preorder. Returns nullptr if the
+// contents can't be parsed.
+Node<StringNodeData> *parseContents(const std::string &filename, const std::string &contents, const std::string &cacheKey,
+									std::vector<NodeSource> *sources)
+{
+	// cached trees carry no source ranges
+	if (astCache && !sources)
+	{
+		if (Node<StringNodeData> *cached = astCache->load(cacheKey))
+			return cached;
+	}
+
+	// without includes there is no preamble to share
+	CXIndex index = nullptr;
+	CXTranslationUnit translationUnit = nullptr;
+	if (fastParse)
+	{
+		index = clang_createIndex(0, verbose);
+		clang_CXIndex_setGlobalOptions(index, clangGlobalOptions);
+		CXUnsavedFile file = {filename.c_str(), contents.data(), contents.size()};
+		clang_parseTranslationUnit2(index,
+									filename.c_str(),
+									defaultArguments,
+									std::extent<decltype(defaultArguments)>::value,
+									&file, 1,
+									CXTranslationUnit_SingleFileParse | CXTranslationUnit_KeepGoing,
+									&translationUnit);
+	} else
+	{
+		if (!preambleCache)
+			preambleCache.reset(new PreambleCache(defaultArguments, std::extent<decltype(defaultArguments)>::value, verbose, clangGlobalOptions));
+		translationUnit = preambleCache->parse(filename, contents);
+	}
 
 	if (!translationUnit)
 	{
-		std::cerr << "Unable to parse translation unit " << filename << std::endl;
-		exit(EXIT_FAILURE);
+		if (index)
+			clang_disposeIndex(index);
+		return nullptr;
 	}
 
 	CXCursor rootCursor = clang_getTranslationUnitCursor(translationUnit);
@@ -111,34 +274,976 @@ Node<StringNodeData> *buildTree(std::string& filename)
 	unsigned int level = 0;
 	if (verbose)
 	{
+		std::lock_guard<std::mutex> lock(outputMutex);
+		std::cerr << "Parsing " << filename << "...\n";
 		clang_visitChildren(rootCursor, visitor, &level);
 	}
 
 	auto *root = new Node<StringNodeData>(new StringNodeData(getCursorKindName(rootKind)));
-	clang_visitChildren(rootCursor, treeBuilder, &root);
+	if (sources)
+		sources->push_back(getNodeSource(rootCursor, getCursorKindName(rootKind)));
+
+	TreeBuilderContext context = {root, sources};
+	clang_visitChildren(rootCursor, treeBuilder, &context);
 
+	if (index)
+	{
+		clang_disposeTranslationUnit(translationUnit);
+		clang_disposeIndex(index);
+	}
+
+	if (canonicalizer)
+		canonicalizeTree(root, sources);
+
+	if (astCache && !sources)
+		astCache->store(cacheKey, root);
+
+	return root;
+}
+
+// Lexes a file for fingerprinting: its tokens without comments, with
+// identifiers and literals replaced by their kind, so that renaming them
+// changes nothing. clang_tokenize needs a translation unit, but lexes the
+// source itself, so the file is parsed on its own and without function
+// bodies. Returns no tokens if the file can't be parsed.
+std::vector<std::string> tokenizeFile(const std::string &filename)
+{
+	std::string contents = readSource(filename);
+	std::vector<std::string> tokens;
+
+	CXIndex index = clang_createIndex(0, verbose);
+	CXUnsavedFile file = {filename.c_str(), contents.data(), contents.size()};
+	CXTranslationUnit translationUnit = nullptr;
+	clang_parseTranslationUnit2(index,
+								filename.c_str(),
+								defaultArguments,
+								std::extent<decltype(defaultArguments)>::value,
+								&file, 1,
+								CXTranslationUnit_SingleFileParse | CXTranslationUnit_SkipFunctionBodies | CXTranslationUnit_KeepGoing,
+								&translationUnit);
+	if (!translationUnit)
+	{
+		clang_disposeIndex(index);
+		return tokens;
+	}
+
+	CXFile mainFile = clang_getFile(translationUnit, filename.c_str());
+	CXSourceRange range = clang_getRange(clang_getLocationForOffset(translationUnit, mainFile, 0),
+										 clang_getLocationForOffset(translationUnit, mainFile, contents.size()));
+	CXToken *cxTokens = nullptr;
+	unsigned count = 0;
+	clang_tokenize(translationUnit, range, &cxTokens, &count);
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		switch (clang_getTokenKind(cxTokens[i]))
+		{
+		case CXToken_Identifier:
+			tokens.push_back("identifier");
+			break;
+		case CXToken_Literal:
+			tokens.push_back("literal");
+			break;
+		case CXToken_Comment:
+			break;
+		default:
+			CXString spelling = clang_getTokenSpelling(translationUnit, cxTokens[i]);
+			tokens.push_back(clang_getCString(spelling));
+			clang_disposeString(spelling);
+		}
+	}
+
+	clang_disposeTokens(translationUnit, cxTokens, count);
 	clang_disposeTranslationUnit(translationUnit);
 	clang_disposeIndex(index);
+	return tokens;
+}
 
+Node<StringNodeData> *parseTree(const std::string &filename, std::vector<NodeSource> *sources)
+{
+	std::string contents = readSource(filename);
+	return parseContents(filename, contents, parseContext(filename, contents) + '\0' + contents, sources);
+}
+
+// reports a file that didn't parse and exits. Parsing threads return null
+// trees instead, and the thread that takes them calls this once they are
+// joined, as exiting while other threads run is undefined.
+void failParse(const std::string &filename)
+{
+	std::cerr << "Unable to parse translation unit " << filename << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+Node<StringNodeData> *buildTree(const std::string &filename, std::vector<NodeSource> *sources = nullptr)
+{
+	Node<StringNodeData> *root = parseTree(filename, sources);
+	if (!root)
+		failParse(filename);
 	return root;
 }
 
 // because the restricts in Capted library, we need this helper function
-float computeEditDistance(Node<StringNodeData> *t1, Node<StringNodeData> *t2) {
-	StringCostModel costModel;
-	Apted<StringNodeData> algorithm(&costModel);
+// all costs are 0 or 1, so the distance tables can use the same narrow integer
+// type the dispatcher picks for the node ids.
+Integer computeEditDistance(Node<StringNodeData> *t1, Node<StringNodeData> *t2) {
+	return dispatchUnitCostEditDistance<BasicStringCostModel>(t1, t2, distanceCache, unitCostModelId);
+}
+
+// prints the node pairs of the mapping that are kept or renamed, in the
+// preorder of the first tree: "=" marks equal kinds, "~" renamed ones.
+void printMapping(const std::vector<IntPair> &mapping, const std::vector<NodeSource> &sources1, const std::vector<NodeSource> &sources2)
+{
+	std::vector<IntPair> matched;
+	for (const IntPair &pair : mapping)
+	{
+		if (pair.first > -1 && pair.second > -1)
+			matched.push_back(pair);
+	}
+	std::sort(matched.begin(), matched.end());
+
+	for (const IntPair &pair : matched)
+	{
+		const NodeSource &s1 = sources1[pair.first];
+		const NodeSource &s2 = sources2[pair.second];
+		std::cout << (s1.kind == s2.kind ? "= " : "~ ")
+				  << s1.kind << " " << s1.startLine << ":" << s1.startColumn << "-" << s1.endLine << ":" << s1.endColumn << " "
+				  << s2.kind << " " << s2.startLine << ":" << s2.startColumn << "-" << s2.endLine << ":" << s2.endColumn << "\n";
+	}
+}
+
+// the one corpus of a run that may be read from an index file
+CorpusIndex *corpusIndex = nullptr;
+
+// the trees of the loaded corpora, with their identical subtrees shared
+TreeStore<StringNodeData> *treeStore = nullptr;
+
+bool isSourceFile(const std::string &name)
+{
+	static const char *extensions[] = {".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx"};
+
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos)
+		return false;
+
+	std::string extension = name.substr(dot);
+	for (const char *e : extensions)
+	{
+		if (extension == e)
+			return true;
+	}
+	return false;
+}
+
+// collects the C and C++ sources below dir
+void listSourceFiles(const std::string &dir, std::vector<std::string> &files)
+{
+	DIR *handle = opendir(dir.c_str());
+	if (!handle)
+	{
+		std::cerr << "Can't open the directory: " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	while (struct dirent *entry = readdir(handle))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string path = dir + "/" + name;
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			continue;
+
+		if (S_ISDIR(info.st_mode))
+			listSourceFiles(path, files);
+		else if (S_ISREG(info.st_mode) && isSourceFile(name))
+			files.push_back(path);
+	}
+	closedir(handle);
+}
+
+// Lists the sources below dir, or the source members of a tar or zip archive
+// as archive/member. Members are read into archiveSources, so that they are
+// parsed from memory without being extracted; must not be called while files
+// are parsed.
+std::vector<std::string> listCorpus(const std::string &dir)
+{
+	std::vector<std::string> files;
+	if (isArchive(dir))
+	{
+		for (ArchiveMember &member : readArchive(dir))
+		{
+			if (!isSourceFile(member.path))
+				continue;
+			// a member archived again replaces the earlier one, as on extraction
+			std::string path = dir + "/" + member.path;
+			if (archiveSources.count(path) == 0)
+				files.push_back(path);
+			archiveSources[path] = std::move(member.contents);
+		}
+	} else
+		listSourceFiles(dir, files);
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+// parses the files with a pool of parseThreads threads
+std::vector<Node<StringNodeData> *> parseFiles(const std::vector<std::string> &files)
+{
+	std::vector<Node<StringNodeData> *> trees(files.size());
+	{
+		ConcurrentQueue<ParsedFile> parsed;
+		ParsePool pool(files.size(), [&files](size_t file) { return parseTree(files[file]); }, parseThreads, parsed);
+
+		for (ParsedFile result; parsed.pop(result);)
+			trees[result.file] = result.tree;
+	}
+
+	for (size_t file = 0; file < files.size(); file++)
+	{
+		if (!trees[file])
+			failParse(files[file]);
+	}
+	return trees;
+}
+
+// a parsed file that can be compared with the files of a loaded corpus
+CorpusFile makeCorpusFile(const std::string &path, Node<StringNodeData> *tree, LabelDictionary<StringNodeData> &labels)
+{
+	return {path, tree, TreeProfile<StringNodeData>(tree, labels), nullptr, -1};
+}
+
+// a parsed file kept in the tree store; the tree is deleted
+CorpusFile storeCorpusFile(const std::string &path, Node<StringNodeData> *tree, LabelDictionary<StringNodeData> &labels)
+{
+	if (!treeStore)
+		treeStore = new TreeStore<StringNodeData>(&labels);
+
+	CorpusFile file = {path, nullptr, TreeProfile<StringNodeData>(tree, labels), treeStore->add(tree), -1};
+	delete tree;
+	return file;
+}
+
+// loads a directory of sources, or an index file written by --write-index.
+// An index has to be loaded before anything else uses labels. Its files take
+// no work beyond their paths until they are compared.
+std::vector<CorpusFile> loadCorpus(const std::string &path, LabelDictionary<StringNodeData> &labels)
+{
+	std::vector<CorpusFile> corpus;
+	if (CorpusIndex::isIndexFile(path))
+	{
+		corpusIndex = new CorpusIndex(path, labels);
+		for (size_t i = 0; i < corpusIndex->size(); i++)
+			corpus.push_back({corpusIndex->getPath(i), nullptr, corpusIndex->getProfile(i), nullptr, (int64_t)i});
+		return corpus;
+	}
+
+	// trees go into the store as they are parsed, so that only a few are
+	// whole at a time
+	std::vector<std::string> files = listCorpus(path);
+	corpus.resize(files.size());
+	size_t failed = files.size();
+	{
+		ConcurrentQueue<ParsedFile> parsed;
+		ParsePool pool(files.size(), [&files](size_t file) { return parseTree(files[file]); }, parseThreads, parsed);
+
+		for (ParsedFile result; parsed.pop(result);)
+		{
+			if (!result.tree)
+				failed = std::min(failed, result.file);
+			else if (functionLevel)
+				corpus[result.file] = makeCorpusFile(files[result.file], result.tree, labels);
+			else
+				corpus[result.file] = storeCorpusFile(files[result.file], result.tree, labels);
+		}
+	}
+	if (failed < files.size())
+		failParse(files[failed]);
+	if (verbose && treeStore)
+		std::cerr << treeStore->getTreeNodes() << " nodes stored as " << treeStore->size() << " shared nodes\n";
+	return corpus;
+}
+
+// the indexer of the tree or DAG of a file with the unit costs of Index
+template<class Index>
+NodeIndexer<StringNodeData, Index, Index> *indexCorpusFile(const CorpusFile &file, FileIndexers &indexers)
+{
+	static BasicStringCostModel<Index> costModel;
+	std::unique_ptr<NodeIndexer<StringNodeData, Index, Index>> &indexer = indexers.get(Index());
+	if (!indexer)
+	{
+		if (file.dag)
+			indexer.reset(new NodeIndexer<StringNodeData, Index, Index>(file.dag, &costModel, treeStore->getLabels()));
+		else
+			indexer.reset(new NodeIndexer<StringNodeData, Index, Index>(file.tree, &costModel));
+	}
+	return indexer.get();
+}
+
+template<class Index>
+Index computeEditDistance(NodeIndexer<StringNodeData, Index, Index> *a, NodeIndexer<StringNodeData, Index, Index> *b)
+{
+	static BasicStringCostModel<Index> costModel;
+	Apted<StringNodeData, Index, Index> algorithm(&costModel);
+	algorithm.setDistanceCache(distanceCache, unitCostModelId);
+	return algorithm.computeEditDistance(a, b);
+}
+
+// the distance of a small tree or DAG and the tree or DAG of a file, if both
+// are small enough for SmallTreeDistance
+template<class Tree>
+bool computeSmallEditDistance(Tree *a, const CorpusFile &b, Integer &distance)
+{
+	static BasicStringCostModel<Integer> costModel;
+	typedef SmallTreeDistance<StringNodeData, Integer, SMALL_TREE_SIZE> Small;
+	LabelDictionary<StringNodeData> *labels = treeStore ? treeStore->getLabels() : nullptr;
+	if (b.dag)
+		return Small::compute(&costModel, a, b.dag, labels, distance);
+	return Small::compute(&costModel, a, b.tree, labels, distance);
+}
+
+void releaseCorpusFile(CorpusFile &file)
+{
+	delete file.tree;
+	if (file.dag)
+		treeStore->release(file.dag);
+}
+
+void releaseCorpus(std::vector<CorpusFile> &corpus)
+{
+	for (CorpusFile &file : corpus)
+		releaseCorpusFile(file);
+}
+
+// a labeled indexer of a file for BatchedDistance, over the labels of the
+// loaded corpus, which its tree store and index use too
+CorpusIndex::Indexer *indexLabeledCorpusFile(const CorpusFile &file, LabelDictionary<StringNodeData> &labels)
+{
+	static BasicStringCostModel<Integer> costModel;
+	if (file.indexEntry >= 0)
+		return corpusIndex->getIndexer(file.indexEntry);
+	if (file.dag)
+		return new CorpusIndex::Indexer(file.dag, &costModel, &labels);
+	return new CorpusIndex::Indexer(file.tree, &costModel, &labels);
+}
+
+// the labeled indexer of a file with at most SMALL_TREE_SIZE nodes, null for
+// larger files and for every file at the function level, where files aren't
+// compared whole. Indexing interns labels, so threads that compare files take
+// the indexers of files that were indexed before.
+CorpusIndex::Indexer *indexSmallCorpusFile(const CorpusFile &file, LabelDictionary<StringNodeData> &labels)
+{
+	if (functionLevel)
+		return nullptr;
+	return file.profile.size <= SMALL_TREE_SIZE ? indexLabeledCorpusFile(file, labels) : nullptr;
+}
+
+// The distance of two files. Stored files take the way of trees: small pairs
+// go to SmallTreeDistance, the others to APTED with the narrowest index type
+// that fits. The views of an index are of type Integer, so pairs with a file
+// of an index are computed at that type. indexersA keeps the indexers of a
+// for later pairs; without it, they are made for this pair only.
+Integer computeEditDistance(const CorpusFile &a, const CorpusFile &b, FileIndexers *indexersA)
+{
+	if (a.tree && b.tree)
+		return computeEditDistance(a.tree, b.tree);
+
+	FileIndexers pairIndexersA, indexersB;
+	if (!indexersA)
+		indexersA = &pairIndexersA;
+
+	if (a.indexEntry >= 0 || b.indexEntry >= 0)
+	{
+		std::unique_ptr<CorpusIndex::Indexer> viewA, viewB;
+		if (a.indexEntry >= 0)
+			viewA.reset(corpusIndex->getIndexer(a.indexEntry));
+		if (b.indexEntry >= 0)
+			viewB.reset(corpusIndex->getIndexer(b.indexEntry));
+		return computeEditDistance(viewA ? viewA.get() : indexCorpusFile<Integer>(a, *indexersA),
+								   viewB ? viewB.get() : indexCorpusFile<Integer>(b, indexersB));
+	}
+
+	Integer distance;
+	if (a.profile.size <= SMALL_TREE_SIZE && b.profile.size <= SMALL_TREE_SIZE
+		&& (a.dag ? computeSmallEditDistance(a.dag, b, distance) : computeSmallEditDistance(a.tree, b, distance)))
+		return distance;
+
+	switch (selectIndexWidth(a.profile.size, b.profile.size))
+	{
+	case IndexWidth::Int16:
+		return computeEditDistance(indexCorpusFile<int16_t>(a, *indexersA), indexCorpusFile<int16_t>(b, indexersB));
+	case IndexWidth::Int32:
+		return computeEditDistance(indexCorpusFile<int32_t>(a, *indexersA), indexCorpusFile<int32_t>(b, indexersB));
+	default:
+		return computeEditDistance(indexCorpusFile<int64_t>(a, *indexersA), indexCorpusFile<int64_t>(b, indexersB));
+	}
+}
+
+// parses the sources below corpusDir and writes them to an index file
+void writeIndex(const std::string &corpusDir, const std::string &indexFile)
+{
+	std::vector<std::string> files = listCorpus(corpusDir);
+	std::vector<Node<StringNodeData> *> trees = parseFiles(files);
+
+	if (!CorpusIndex::write(indexFile, files, trees))
+	{
+		std::cerr << "Can't write the index: " << indexFile << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (verbose)
+		std::cerr << files.size() << " files indexed\n";
+
+	for (Node<StringNodeData> *tree : trees)
+		delete tree;
+}
+
+// All costs are 0 or 1 and no node kind is empty, so the distance of a tree to
+// the single-node tree "" is its size, and the similarity of the two-file mode
+// is 1 - d / (n1 + n2).
+float unitCostSimilarity(Integer distance, Integer size1, Integer size2)
+{
+	return 1 - (float)distance / (size1 + size2);
+}
+
+// the largest distance at which two trees can reach the given similarity
+Integer distanceBudget(float similarity, Integer size1, Integer size2)
+{
+	Integer budget = std::floor((1 - similarity) * (size1 + size2));
+
+	// agree with unitCostSimilarity where rounding differs
+	if (unitCostSimilarity(budget + 1, size1, size2) >= similarity)
+		budget++;
+	return budget;
+}
+
+// Whether files of the sizes can be minSimilarity similar, as their sizes
+// differ by no more than their distance. budget is set to the distance budget
+// of the pair either way.
+bool sizesCanMatch(Integer size1, Integer size2, float minSimilarity, Integer &budget)
+{
+	budget = distanceBudget(minSimilarity, size1, size2);
+	return std::abs(size1 - size2) <= budget;
+}
+
+// a function definition within the tree of a file
+struct FunctionTree
+{
+	Node<StringNodeData> *root;
+	Integer preorder;
+	Integer size;
+	TreeProfile<StringNodeData> profile;
+};
+
+// two functions with a lower similarity count as unmatched
+const float minFunctionSimilarity = 0.5;
+
+bool isFunctionDefinition(Node<StringNodeData> *node)
+{
+	static const char *kinds[] = {"FunctionDecl", "CXXMethod", "CXXConstructor", "CXXDestructor", "ConversionFunction", "FunctionTemplate"};
+
+	const std::string &kind = node->getData()->getLabel();
+	if (std::find(std::begin(kinds), std::end(kinds), kind) == std::end(kinds))
+		return false;
+
+	// declarations without a body are left to the rest of the file
+	for (Node<StringNodeData> *child : node->getChildren())
+	{
+		if (child->getData()->getLabel() == "CompoundStmt")
+			return true;
+	}
+	return false;
+}
+
+// collects the outermost function definitions below node, whose preorder id
+// is preorder; functions within them stay part of them
+void collectFunctions(Node<StringNodeData> *node, Integer &preorder, LabelDictionary<StringNodeData> &labels, std::vector<FunctionTree> &functions)
+{
+	if (isFunctionDefinition(node))
+	{
+		TreeProfile<StringNodeData> profile(node, labels);
+		functions.push_back({node, preorder, profile.size, profile});
+		preorder += profile.size;
+		return;
+	}
+
+	preorder++;
+	for (Node<StringNodeData> *child : node->getChildren())
+		collectFunctions(child, preorder, labels, functions);
+}
+
+// copies the tree below node without the function definitions that
+// collectFunctions takes out of it: the rest of the file
+Node<StringNodeData> *cutFunctions(Node<StringNodeData> *node)
+{
+	auto *copy = new Node<StringNodeData>(new StringNodeData(node->getData()->getLabel()));
+	for (Node<StringNodeData> *child : node->getChildren())
+	{
+		if (!isFunctionDefinition(child))
+			copy->addChild(cutFunctions(child));
+	}
+	return copy;
+}
+
+// Compares two files function by function: the distances of all pairs of
+// functions go into an assignment problem, where leaving a function unmatched
+// costs its size, and pairs less similar than minFunctionSimilarity cost as
+// much as leaving both unmatched, which spares computing their distance when
+// the bounds rule them out. The rest of each file, its tree with the functions
+// cut out, is one more item, paired with the rest of the other file at their
+// distance; paired with a function, it costs both sizes. The similarity is
+// 1 - cost / (n1 + n2), so declarations, globals and the like count by their
+// size too. Files without functions are compared whole. matches, if given,
+// receives the preorder ids of the functions that are paired up with their
+// similarity. A small function is compared with the small functions of the
+// other file that pass the bounds in one go, with BatchedDistance. Function
+// pairs go through the distance cache, small ones too, as functions recur
+// across the files of a corpus. Rows of pairs are spread over threadCount
+// threads; comparisons that run in threads of their own take one.
+float functionSimilarity(Node<StringNodeData> *t1, Node<StringNodeData> *t2, std::vector<std::pair<IntPair, float>> *matches = nullptr,
+						 long threadCount = parseThreads)
+{
+	LabelDictionary<StringNodeData> labels;
+	std::vector<FunctionTree> functions1, functions2;
+	Integer preorder = 0;
+	collectFunctions(t1, preorder, labels, functions1);
+	preorder = 0;
+	collectFunctions(t2, preorder, labels, functions2);
+
+	Integer n1 = t1->getNodeCount(), n2 = t2->getNodeCount();
+	if (functions1.empty() && functions2.empty())
+		return unitCostSimilarity(computeEditDistance(t1, t2), n1, n2);
+
+	// the rest of the files are item m and n, unmatched items pair up with
+	// padding
+	Node<StringNodeData> *rest1 = cutFunctions(t1);
+	Node<StringNodeData> *rest2 = cutFunctions(t2);
+	size_t m = functions1.size(), n = functions2.size();
+	size_t k = std::max(m, n) + 1;
+	std::vector<Integer> sizes1(k, 0), sizes2(k, 0);
+	for (size_t i = 0; i < m; i++)
+		sizes1[i] = functions1[i].size;
+	for (size_t j = 0; j < n; j++)
+		sizes2[j] = functions2[j].size;
+	sizes1[m] = rest1->getNodeCount();
+	sizes2[n] = rest2->getNodeCount();
+
+	std::vector<std::vector<long long>> cost(k, std::vector<long long>(k));
+	for (size_t i = 0; i < k; i++)
+	{
+		for (size_t j = 0; j < k; j++)
+			cost[i][j] = sizes1[i] + sizes2[j];
+	}
+	cost[m][n] = computeEditDistance(rest1, rest2);
+	delete rest1;
+	delete rest2;
+
+	// small functions are indexed up front, as indexing interns labels and
+	// the threads only read them
+	static BasicStringCostModel<Integer> costModel;
+	typedef NodeIndexer<StringNodeData, Integer, Integer> Indexer;
+	auto indexSmallFunctions = [&](const std::vector<FunctionTree> &functions) {
+		std::vector<std::unique_ptr<Indexer>> indexers(functions.size());
+		for (size_t f = 0; f < functions.size(); f++)
+		{
+			if (functions[f].size <= SMALL_TREE_SIZE)
+				indexers[f].reset(new Indexer(functions[f].root, &costModel, &labels));
+		}
+		return indexers;
+	};
+	std::vector<std::unique_ptr<Indexer>> indexers1 = indexSmallFunctions(functions1);
+	std::vector<std::unique_ptr<Indexer>> indexers2 = indexSmallFunctions(functions2);
+
+	// the pairs are independent, so threads take rows of them
+	std::atomic<size_t> nextRow(0);
+	std::vector<std::thread> threads;
+	for (long thread = 0; thread < std::min<long>(threadCount, m); thread++)
+	{
+		threads.emplace_back([&]() {
+			BatchedDistance<StringNodeData, Integer, Integer> batched;
+			std::vector<Indexer *> batch;
+			std::vector<size_t> batchColumns;
+			for (size_t i = nextRow++; i < m; i = nextRow++)
+			{
+				const FunctionTree &f1 = functions1[i];
+				for (size_t j = 0; j < n; j++)
+				{
+					const FunctionTree &f2 = functions2[j];
+					Integer budget;
+					Integer unmatched = f1.size + f2.size;
+					if (!sizesCanMatch(f1.size, f2.size, minFunctionSimilarity, budget) || labelBagLowerBound(f1.profile, f2.profile) > budget
+						|| traversalLowerBound(f1.profile, f2.profile, budget) > budget)
+					{
+						cost[i][j] = unmatched;
+						continue;
+					}
+					double cached;
+					if (indexers1[i] && indexers2[j] && distanceCache
+						&& distanceCache->find(indexers1[i]->getHash(0), f1.size, indexers2[j]->getHash(0), f2.size, unitCostModelId, cached))
+					{
+						cost[i][j] = cached > budget ? unmatched : (long long)cached;
+						continue;
+					}
+					if (indexers1[i] && indexers2[j])
+					{
+						batch.push_back(indexers2[j].get());
+						batchColumns.push_back(j);
+						continue;
+					}
+					Integer distance = computeEditDistance(f1.root, f2.root);
+					cost[i][j] = distance > budget ? unmatched : distance;
+				}
+
+				if (batch.empty())
+					continue;
+				std::vector<Integer> distances = batched.computeEditDistances(indexers1[i].get(), batch);
+				for (size_t c = 0; c < distances.size(); c++)
+				{
+					size_t j = batchColumns[c];
+					if (distanceCache)
+					{
+						distanceCache->insert(indexers1[i]->getHash(0), f1.size, indexers2[j]->getHash(0), functions2[j].size,
+											  unitCostModelId, distances[c]);
+					}
+					Integer budget = distanceBudget(minFunctionSimilarity, f1.size, functions2[j].size);
+					cost[i][j] = distances[c] > budget ? f1.size + functions2[j].size : distances[c];
+				}
+				batch.clear();
+				batchColumns.clear();
+			}
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	std::vector<int> assignment = minimumCostAssignment(cost);
+	long long total = 0;
+	for (size_t i = 0; i < k; i++)
+	{
+		size_t j = assignment[i];
+		total += cost[i][j];
+		if (matches && i < m && j < n && cost[i][j] < functions1[i].size + functions2[j].size)
+		{
+			float similarity = unitCostSimilarity(cost[i][j], functions1[i].size, functions2[j].size);
+			matches->push_back({{functions1[i].preorder, functions2[j].preorder}, similarity});
+		}
+	}
+	return 1 - (float)total / (n1 + n2);
+}
 
-	float compDist = algorithm.computeEditDistance(t1, t2);
+// prints the functions paired up by functionSimilarity: their similarity and
+// their source ranges in both files
+void printFunctionMatches(const std::vector<std::pair<IntPair, float>> &matches, const std::vector<NodeSource> &sources1, const std::vector<NodeSource> &sources2)
+{
+	for (const std::pair<IntPair, float> &match : matches)
+	{
+		const NodeSource &s1 = sources1[match.first.first];
+		const NodeSource &s2 = sources2[match.first.second];
+		std::cout << match.second << " "
+				  << s1.kind << " " << s1.startLine << ":" << s1.startColumn << "-" << s1.endLine << ":" << s1.endColumn << " "
+				  << s2.kind << " " << s2.startLine << ":" << s2.startColumn << "-" << s2.endLine << ":" << s2.endColumn << "\n";
+	}
+}
 
-	return compDist;
+// the similarity of two files of corpora, whole or function by function.
+// indexersA is that of computeEditDistance; comparisons that run in threads
+// of their own give a threadCount of 1.
+float fileSimilarity(const CorpusFile &a, const CorpusFile &b, FileIndexers *indexersA, long threadCount)
+{
+	if (functionLevel)
+		return functionSimilarity(a.tree, b.tree, nullptr, threadCount);
+	return unitCostSimilarity(computeEditDistance(a, b, indexersA), a.profile.size, b.profile.size);
+}
+
+// Returns the k files of the corpus most similar to the query, best first,
+// as pairs of similarity and position in the corpus.
+//
+// Candidates are visited in decreasing order of the similarity bound from
+// their label bags, so that the k-th best similarity found so far grows
+// quickly. Once it reaches the bound of the next candidate, no remaining
+// candidate can enter the top k. Before that, the k-th best similarity gives
+// each candidate a distance budget, and the traversal bound rules out those
+// that can't stay within it before the exact distance is computed.
+//
+// If the query is small, the small candidates that pass the bounds are
+// compared a batch at a time with BatchedDistance, one per lane. Their
+// similarities count for the k-th best once their batch is complete, which
+// makes the bounds of the candidates in between a little less tight. labels
+// are those of the corpus and the query.
+//
+// At the function level, the label bag and traversal bounds of whole trees
+// don't hold, but the sizes still bound the similarity from above: every item
+// of the assignment costs at least the difference of its sizes. Candidates
+// are visited by that bound then, and none is batched.
+std::vector<std::pair<float, size_t>> findTopK(const CorpusFile &queryFile, const std::vector<CorpusFile> &corpus, size_t k,
+											   LabelDictionary<StringNodeData> &labels)
+{
+	const TreeProfile<StringNodeData> &query = queryFile.profile;
+
+	std::vector<std::pair<float, size_t>> order;
+	for (size_t i = 0; i < corpus.size(); i++)
+	{
+		const TreeProfile<StringNodeData> &profile = corpus[i].profile;
+		Integer bound = functionLevel ? std::abs(query.size - profile.size) : labelBagLowerBound(query, profile);
+		order.push_back({unitCostSimilarity(bound, query.size, profile.size), i});
+	}
+	std::sort(order.begin(), order.end(), [](const std::pair<float, size_t> &a, const std::pair<float, size_t> &b) {
+		return a.first > b.first;
+	});
+
+	// the best k so far, the k-th best on top
+	typedef std::pair<float, size_t> Result;
+	FileIndexers queryIndexers;
+	std::priority_queue<Result, std::vector<Result>, std::greater<Result>> best;
+	size_t visited = 0, traversalPruned = 0, computed = 0, batchedCount = 0;
+
+	auto offer = [&](float similarity, size_t file) {
+		if (best.size() < k)
+			best.push({similarity, file});
+		else if (similarity > best.top().first)
+		{
+			best.pop();
+			best.push({similarity, file});
+		}
+	};
+
+	// candidates are indexed as they come up, most are never compared
+	SmallPairBatch batch;
+	std::unique_ptr<CorpusIndex::Indexer> queryIndexer(indexSmallCorpusFile(queryFile, labels));
+	batch.query = queryIndexer.get();
+	std::vector<std::unique_ptr<CorpusIndex::Indexer>> candidateIndexers;
+	auto report = [&](size_t file, Integer distance) {
+		offer(unitCostSimilarity(distance, query.size, corpus[file].profile.size), file);
+	};
+
+	for (const std::pair<float, size_t> &candidate : order)
+	{
+		if (best.size() == k && candidate.first <= best.top().first)
+			break;
+		visited++;
+
+		const CorpusFile &file = corpus[candidate.second];
+		if (best.size() == k && !functionLevel)
+		{
+			Integer budget = distanceBudget(best.top().first, query.size, file.profile.size);
+			if (traversalLowerBound(query, file.profile, budget) > budget)
+			{
+				traversalPruned++;
+				continue;
+			}
+		}
+
+		computed++;
+		if (batch.query && file.profile.size <= SMALL_TREE_SIZE)
+		{
+			candidateIndexers.emplace_back(indexLabeledCorpusFile(file, labels));
+			batchedCount++;
+			batch.add(candidateIndexers.back().get(), candidate.second, report);
+			continue;
+		}
+
+		offer(fileSimilarity(queryFile, file, &queryIndexers), candidate.second);
+	}
+	batch.compute(report);
+
+	if (verbose)
+	{
+		std::cerr << corpus.size() << " candidates: " << corpus.size() - visited << " pruned by label bags, "
+				  << traversalPruned << " by traversals, " << computed << " distances computed, "
+				  << batchedCount << " of them in batches\n";
+	}
+
+	std::vector<Result> results;
+	for (; !best.empty(); best.pop())
+		results.push_back(best.top());
+	std::reverse(results.begin(), results.end());
+	return results;
+}
+
+// prints the k files of the corpus most similar to the query, best first
+void queryTopK(const std::string &queryFile, const std::string &corpusDir, size_t k)
+{
+	LabelDictionary<StringNodeData> labels;
+	std::vector<CorpusFile> corpus = loadCorpus(corpusDir, labels);
+	std::string queryPath = queryFile;
+	std::vector<CorpusFile> queryCorpus = {makeCorpusFile(queryPath, buildTree(queryPath), labels)};
+
+	for (const std::pair<float, size_t> &result : findTopK(queryCorpus.front(), corpus, k, labels))
+		std::cout << result.first << "\t" << corpus[result.second].path << "\n";
+
+	releaseCorpus(queryCorpus);
+	releaseCorpus(corpus);
+}
+
+// Parses every file below dir both ways and prints how far the tree of the
+// fast parse is from the tree of the full parse, per file and in total, along
+// with the time either way took.
+void validateFastParse(const std::string &dir)
+{
+	typedef std::chrono::steady_clock Clock;
+	std::vector<std::string> files = listCorpus(dir);
+	std::chrono::duration<double> fullTime(0), fastTime(0);
+	size_t identical = 0;
+	double similaritySum = 0;
+
+	for (std::string &file : files)
+	{
+		fastParse = false;
+		Clock::time_point start = Clock::now();
+		Node<StringNodeData> *full = buildTree(file);
+		fullTime += Clock::now() - start;
+
+		fastParse = true;
+		start = Clock::now();
+		Node<StringNodeData> *fast = buildTree(file);
+		fastTime += Clock::now() - start;
+
+		Integer fullSize = full->getNodeCount();
+		Integer fastSize = fast->getNodeCount();
+		Integer distance = computeEditDistance(full, fast);
+		float similarity = unitCostSimilarity(distance, fullSize, fastSize);
+		identical += distance == 0;
+		similaritySum += similarity;
+		std::cout << similarity << "\t" << distance << "\t" << fullSize << "\t" << fastSize << "\t" << file << "\n";
+
+		delete full;
+		delete fast;
+	}
+
+	if (!files.empty())
+	{
+		std::cout << files.size() << " files: " << identical << " identical, mean similarity " << similaritySum / files.size()
+				  << ", full parse " << fullTime.count() << "s, fast parse " << fastTime.count() << "s" << std::endl;
+	}
+}
+
+// Parses every file below dir as is and compares each file with the next one
+// twice, as parsed and canonicalized. Prints the similarities either way per
+// pair, followed by the share of nodes canonicalization removed and the time
+// the distances took either way.
+void validateCanonicalization(const std::string &dir)
+{
+	typedef std::chrono::steady_clock Clock;
+	Canonicalizer *configured = canonicalizer;
+	canonicalizer = nullptr;
+	std::vector<std::string> files = listCorpus(dir);
+	std::vector<Node<StringNodeData> *> trees = parseFiles(files);
+
+	std::vector<Node<StringNodeData> *> canonical;
+	for (Node<StringNodeData> *tree : trees)
+	{
+		canonical.push_back(tree->clone());
+		configured->canonicalize(canonical.back());
+	}
+
+	std::chrono::duration<double> parsedTime(0), canonicalTime(0);
+	for (size_t i = 1; i < files.size(); i++)
+	{
+		Clock::time_point start = Clock::now();
+		Integer distance = computeEditDistance(trees[i - 1], trees[i]);
+		parsedTime += Clock::now() - start;
+
+		start = Clock::now();
+		Integer canonicalDistance = computeEditDistance(canonical[i - 1], canonical[i]);
+		canonicalTime += Clock::now() - start;
+
+		std::cout << unitCostSimilarity(distance, trees[i - 1]->getNodeCount(), trees[i]->getNodeCount()) << "\t"
+				  << unitCostSimilarity(canonicalDistance, canonical[i - 1]->getNodeCount(), canonical[i]->getNodeCount()) << "\t"
+				  << files[i - 1] << "\t" << files[i] << "\n";
+	}
+
+	if (!files.empty())
+	{
+		std::cout << files.size() << " files: " << configured->getRemoved() << " of " << configured->getNodes() << " nodes removed ("
+				  << 100.0 * configured->getRemoved() / configured->getNodes() << "%), distances as parsed "
+				  << parsedTime.count() << "s, canonicalized " << canonicalTime.count() << "s" << std::endl;
+	}
+
+	for (size_t i = 0; i < trees.size(); i++)
+	{
+		delete trees[i];
+		delete canonical[i];
+	}
+	canonicalizer = configured;
+}
+
+// reports the nodes canonicalization removed at exit
+void reportCanonicalization()
+{
+	if (verbose && canonicalizer->getNodes() > 0)
+	{
+		std::cerr << "canonicalization: " << canonicalizer->getRemoved() << " of " << canonicalizer->getNodes()
+				  << " nodes removed\n";
+	}
+}
+
+// reports the lookups of the distance cache at exit
+void reportDistanceCache()
+{
+	if (verbose)
+	{
+		std::cerr << "distance cache: " << distanceCache->getHits() << " hits, " << distanceCache->getMisses()
+				  << " misses, hit rate " << distanceCache->getHitRate() << "\n";
+	}
+}
+
+void printUsage()
+{
+	std::cout << "usage: codesim [-v|--verbose] [-C|--cache dir] [-m|--mapping] [-F|--functions] [-h|--help] code1 code2\n"
+			  << "       codesim [-v|--verbose] [-C|--cache dir] [-F|--functions] -q|--query code -c|--corpus dir [-k|--top k]\n"
+			  << "       codesim [-v|--verbose] [-C|--cache dir] [-F|--functions] -j|--join dirA dirB -s|--min-similarity s [-P|--prefilter overlap]\n"
+			  << "       codesim [-v|--verbose] [-C|--cache dir] [-F|--functions] -a|--all-pairs dir [-e|--format csv|jsonl|sparse|binary] [-o|--output file] [-s|--min-similarity s]\n"
+			  << "       codesim [-v|--verbose] [-C|--cache dir] -c|--corpus dir -w|--write-index file\n"
+			  << "       codesim [-v|--verbose] -V|--validate-fast-parse dir\n"
+			  << "       codesim [-v|--verbose] [-C|--cache dir] [-c|--corpus dir] -S|--serve socket\n"
+			  << "       codesim [-v|--verbose] [-C|--cache dir] -W|--watch dir [-s|--min-similarity s]\n"
+			  << "       codesim [-v|--verbose] [-C|--cache dir] -g|--git repository revision1 revision2\n"
+			  << "       codesim [-v|--verbose] [-N|--canonicalize[=kinds]] -K|--validate-canonicalize dir\n"
+			  << "-f|--fast-parse parses files without their includes\n"
+			  << "-N|--canonicalize[=kinds] removes nodes of the comma-separated kinds (default UnexposedExpr), nested blocks and unary chains\n"
+			  << "-t|--threads n parses the files of corpora with n threads\n"
+			  << "-D|--distance-cache n keeps the distances of the last n pairs of trees\n"
+			  << "--corpus and either side of --join can also be an index file, except with --functions\n"
+			  << "a corpus dir can also be a tar archive or a zip archive of stored files" << std::endl;
 }
 
 int main(int argc, char **argv)
 {
-	const char *optstring = "vh";
+	bool mapping = false;
+	std::string queryFile, corpusDir, joinDir, indexFile, validationDir, serveSocket, watchDir, gitRepository;
+	std::string canonicalValidationDir, allPairsDir;
+	std::string format = "csv", output = "-";
+	long top = 10;
+	long distanceCacheSize = 0;
+	float minSimilarity = -1;
+	double minOverlap = -1;
+	std::string cacheDir;
+	const char *optstring = "vC:mq:c:k:j:s:P:a:e:o:w:fV:N::K:t:D:S:W:g:Fh";
 	int c;
 	struct option opts[] = {
 		{"verbose", 0, nullptr, 'v'},
+		{"cache", 1, nullptr, 'C'},
+		{"mapping", 0, nullptr, 'm'},
+		{"query", 1, nullptr, 'q'},
+		{"corpus", 1, nullptr, 'c'},
+		{"top", 1, nullptr, 'k'},
+		{"join", 1, nullptr, 'j'},
+		{"min-similarity", 1, nullptr, 's'},
+		{"prefilter", 1, nullptr, 'P'},
+		{"all-pairs", 1, nullptr, 'a'},
+		{"format", 1, nullptr, 'e'},
+		{"output", 1, nullptr, 'o'},
+		{"write-index", 1, nullptr, 'w'},
+		{"fast-parse", 0, nullptr, 'f'},
+		{"validate-fast-parse", 1, nullptr, 'V'},
+		{"canonicalize", 2, nullptr, 'N'},
+		{"validate-canonicalize", 1, nullptr, 'K'},
+		{"threads", 1, nullptr, 't'},
+		{"distance-cache", 1, nullptr, 'D'},
+		{"serve", 1, nullptr, 'S'},
+		{"watch", 1, nullptr, 'W'},
+		{"git", 1, nullptr, 'g'},
+		{"functions", 0, nullptr, 'F'},
 		{"help", 0, nullptr, 'h'},
 		{nullptr, 0, nullptr, 0},
 	};
@@ -150,20 +1255,228 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose = true;
 			break;
+		case 'C':
+			cacheDir = optarg;
+			break;
+		case 'm':
+			mapping = true;
+			break;
+		case 'q':
+			queryFile = optarg;
+			break;
+		case 'c':
+			corpusDir = optarg;
+			break;
+		case 'k':
+			top = strtol(optarg, nullptr, 10);
+			break;
+		case 'j':
+			joinDir = optarg;
+			break;
+		case 's':
+			minSimilarity = strtof(optarg, nullptr);
+			break;
+		case 'P':
+			minOverlap = strtod(optarg, nullptr);
+			break;
+		case 'a':
+			allPairsDir = optarg;
+			break;
+		case 'e':
+			format = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'w':
+			indexFile = optarg;
+			break;
+		case 'f':
+			fastParse = true;
+			break;
+		case 'V':
+			validationDir = optarg;
+			break;
+		case 'N':
+			delete canonicalizer;
+			canonicalizer = optarg ? new Canonicalizer(optarg) : new Canonicalizer();
+			break;
+		case 'K':
+			canonicalValidationDir = optarg;
+			break;
+		case 't':
+			parseThreads = strtol(optarg, nullptr, 10);
+			break;
+		case 'D':
+			distanceCacheSize = strtol(optarg, nullptr, 10);
+			break;
+		case 'S':
+			serveSocket = optarg;
+			break;
+		case 'W':
+			watchDir = optarg;
+			break;
+		case 'g':
+			gitRepository = optarg;
+			break;
+		case 'F':
+			functionLevel = true;
+			break;
 		case 'h':
 		case '?':
-			std::cout << "usage: codesim [-v|--verbose] [-h|--help] code1 code2" << std::endl;
+			printUsage();
 			exit(EXIT_SUCCESS);
 		default:
 			; // will not happen
 		}
 	}
 
+	if (parseThreads < 1 || distanceCacheSize < 0)
+	{
+		printUsage();
+		exit(EXIT_FAILURE);
+	}
+	if (distanceCacheSize > 0)
+	{
+		distanceCache = new DistanceCache(distanceCacheSize);
+		atexit(reportDistanceCache);
+	}
+	// parsing threads take all cores, so let them yield to interactive work
+	if (parseThreads > 1)
+		clangGlobalOptions = CXGlobalOpt_ThreadBackgroundPriorityForAll;
+
+	if (canonicalizer)
+		atexit(reportCanonicalization);
+
+	// the comparison has to parse both ways
+	if (!validationDir.empty())
+	{
+		validateFastParse(validationDir);
+		return 0;
+	}
+	if (!canonicalValidationDir.empty())
+	{
+		if (!canonicalizer)
+			canonicalizer = new Canonicalizer();
+		validateCanonicalization(canonicalValidationDir);
+		return 0;
+	}
+
+	if (!cacheDir.empty())
+		astCache = new AstCache(cacheDir, getParseSignature());
+
+	// the other modes compare whole files, serve and watch on request, or
+	// stored files, which have no trees
+	bool wholeFiles = !gitRepository.empty() || !watchDir.empty() || !serveSocket.empty() || !indexFile.empty()
+		|| (!corpusDir.empty() && CorpusIndex::isIndexFile(corpusDir))
+		|| (!joinDir.empty() && (CorpusIndex::isIndexFile(joinDir) || (argc > optind && CorpusIndex::isIndexFile(argv[optind]))));
+	if (functionLevel && wholeFiles)
+	{
+		printUsage();
+		exit(EXIT_FAILURE);
+	}
+
+	if (!gitRepository.empty())
+	{
+		// getopt moves the revisions behind the options
+		if (argc < optind + 2)
+		{
+			printUsage();
+			exit(EXIT_FAILURE);
+		}
+		compareRevisions(gitRepository, argv[optind], argv[optind + 1]);
+		return 0;
+	}
+
+	if (!watchDir.empty())
+	{
+		// all pairs unless a threshold is given
+		if (minSimilarity > 1)
+		{
+			printUsage();
+			exit(EXIT_FAILURE);
+		}
+		watchCorpus(watchDir, std::max(minSimilarity, 0.0f));
+		return 0;
+	}
+
+	if (!serveSocket.empty())
+	{
+		serve(serveSocket, corpusDir);
+		return 0;
+	}
+
+	if (!indexFile.empty())
+	{
+		if (corpusDir.empty() || !queryFile.empty() || CorpusIndex::isIndexFile(corpusDir))
+		{
+			printUsage();
+			exit(EXIT_FAILURE);
+		}
+
+		writeIndex(corpusDir, indexFile);
+		return 0;
+	}
+
+	if (!allPairsDir.empty())
+	{
+		if (minSimilarity > 1)
+		{
+			printUsage();
+			exit(EXIT_FAILURE);
+		}
+		compareAllPairs(allPairsDir, format, output, minSimilarity);
+		return 0;
+	}
+
+	if (!queryFile.empty() || !corpusDir.empty())
+	{
+		if (queryFile.empty() || corpusDir.empty() || top < 1)
+		{
+			printUsage();
+			exit(EXIT_FAILURE);
+		}
+		if (!std::ifstream(queryFile).good()) {
+			std::cout << "Can't open the file: " << queryFile << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		queryTopK(queryFile, corpusDir, top);
+		return 0;
+	}
+
+	if (!joinDir.empty())
+	{
+		// getopt moves the second directory behind the options
+		if (argc < optind + 1 || minSimilarity < 0 || minSimilarity > 1)
+		{
+			printUsage();
+			exit(EXIT_FAILURE);
+		}
+
+		// index files are loaded whole, directories can be streamed
+		bool indexed = CorpusIndex::isIndexFile(joinDir) || CorpusIndex::isIndexFile(argv[optind]);
+		if (minOverlap >= 0)
+		{
+			// fingerprints need the sources
+			if (indexed || minOverlap > 1)
+			{
+				printUsage();
+				exit(EXIT_FAILURE);
+			}
+			joinCorporaByFingerprints(joinDir, argv[optind], minSimilarity, minOverlap);
+		} else if (indexed)
+			joinCorpora(joinDir, argv[optind], minSimilarity);
+		else
+			joinCorporaPipelined(joinDir, argv[optind], minSimilarity);
+		return 0;
+	}
+
 	// make sure there are enough input source files
 	std::string f1, f2;
 	if (argc < optind + 2)
 	{
-		std::cout << "usage: codesim [-v|--verbose] [-h|--help] code1 code2" << std::endl;
+		printUsage();
 		exit(EXIT_FAILURE);
 	} else
 	{
@@ -183,17 +1496,43 @@ int main(int argc, char **argv)
 		}
 	}
 
-	Node<StringNodeData> *n1 = buildTree(f1);
-	Node<StringNodeData> *n2 = buildTree(f2);
+	std::vector<NodeSource> sources1, sources2;
+	Node<StringNodeData> *n1 = buildTree(f1, mapping ? &sources1 : nullptr);
+	Node<StringNodeData> *n2 = buildTree(f2, mapping ? &sources2 : nullptr);
+
+	if (functionLevel)
+	{
+		std::vector<std::pair<IntPair, float>> matches;
+		std::cout << functionSimilarity(n1, n2, mapping ? &matches : nullptr) << "\n";
+		if (mapping)
+			printFunctionMatches(matches, sources1, sources2);
+		return 0;
+	}
 
-	float DistAB = computeEditDistance(n1, n2);
+	// the mapping is backtracked from the subtree distances of the distance
+	// computation, so both come from the same instance.
+	Integer DistAB;
+	std::vector<IntPair> editMapping;
+	if (mapping)
+	{
+		BasicStringCostModel<Integer> costModel;
+		Apted<StringNodeData, Integer, Integer> algorithm(&costModel);
+		DistAB = algorithm.computeEditDistance(n1, n2);
+		editMapping = algorithm.computeEditMapping();
+	} else
+	{
+		DistAB = computeEditDistance(n1, n2);
+	}
 
 	auto *emptyTree = new Node<StringNodeData>(new StringNodeData(""));
-	float DistA0 = computeEditDistance(n1, emptyTree);
-	float DistB0 = computeEditDistance(n2, emptyTree);
+	Integer DistA0 = computeEditDistance(n1, emptyTree);
+	Integer DistB0 = computeEditDistance(n2, emptyTree);
+
+	float similarity = 1 - (float)DistAB / (DistA0 + DistB0);
+	std::cout << similarity << "\n";
 
-	float similarity = 1 - DistAB / (DistA0 + DistB0);
-	std::cout << similarity << std::endl;
+	if (mapping)
+		printMapping(editMapping, sources1, sources2);
 
 	return 0;
 }
@@ -0,0 +1,87 @@
+#include "AllPairs.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Codesim.h"
+#include "Join.h"
+#include "ResultWriter.h"
+
+using namespace capted;
+
+void compareAllPairs(const std::string &dir, const std::string &format, const std::string &output, float minSimilarity)
+{
+	std::vector<std::string> files = listCorpus(dir);
+	std::unique_ptr<ResultWriter> writer(ResultWriter::create(format, output, files));
+	if (!writer)
+	{
+		std::cerr << "Can't write " << format << " results to " << output << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	LabelDictionary<StringNodeData> labels;
+	std::vector<CorpusFile> corpus;
+	std::vector<Node<StringNodeData> *> trees = parseFiles(files);
+	for (size_t i = 0; i < files.size(); i++)
+		corpus.push_back(makeCorpusFile(files[i], trees[i], labels));
+	std::vector<std::unique_ptr<CorpusIndex::Indexer>> small = indexSmallCorpus(corpus, labels);
+
+	// rows get shorter towards the end, so threads take one row at a time
+	JoinStats stats;
+	std::mutex writerMutex;
+	std::atomic<size_t> nextRow(0);
+	std::vector<std::thread> comparers;
+	for (long t = 0; t < parseThreads; t++)
+	{
+		comparers.emplace_back([&]() {
+			RowComparer row(stats);
+			for (size_t i; (i = nextRow++) < corpus.size();)
+			{
+				const CorpusFile &a = corpus[i];
+				auto found = [&](size_t j, float similarity) {
+					if (minSimilarity >= 0)
+					{
+						if (similarity < minSimilarity)
+							return;
+						stats.matches++;
+					}
+					std::lock_guard<std::mutex> lock(writerMutex);
+					writer->write(i, j, similarity);
+				};
+
+				row.start(a, small[i].get());
+				for (size_t j = i + 1; j < corpus.size(); j++)
+				{
+					const CorpusFile &b = corpus[j];
+					if (minSimilarity >= 0)
+					{
+						Integer budget;
+						if (!sizesCanMatch(a.profile.size, b.profile.size, minSimilarity, budget))
+							continue;
+						stats.sizePairs++;
+						if (!withinBounds(a, b, budget, stats))
+							continue;
+					}
+					row.compare(b, small[j].get(), j, found);
+				}
+				row.finish(found);
+			}
+		});
+	}
+	for (std::thread &comparer : comparers)
+		comparer.join();
+
+	if (!writer->close())
+	{
+		std::cerr << "Can't write " << format << " results to " << output << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (verbose)
+		stats.print(files.size() * (files.size() - (files.size() > 0)) / 2);
+
+	releaseCorpus(corpus);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Compares every pair of files below dir and writes the similarities in the
+// format to output, each pair once, as they are computed by parseThreads
+// threads. With a minimum similarity (at least 0), only the pairs that reach
+// it are written, and the distance bounds rule out the others first.
+void compareAllPairs(const std::string &dir, const std::string &format, const std::string &output, float minSimilarity);
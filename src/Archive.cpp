@@ -0,0 +1,205 @@
+#include "Archive.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+
+const size_t BLOCK = 512;
+
+[[noreturn]] void fail(const std::string &path, const std::string &message)
+{
+	std::cerr << "Can't read the archive " << path << ": " << message << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+bool isTar(const std::string &data)
+{
+	// "ustar\0" for POSIX, "ustar " for GNU
+	return data.size() >= BLOCK && data.compare(257, 5, "ustar") == 0;
+}
+
+bool isZip(const std::string &data)
+{
+	return data.compare(0, 4, "PK\x03\x04") == 0 || data.compare(0, 4, "PK\x05\x06") == 0;
+}
+
+std::string field(const char *start, size_t length)
+{
+	return std::string(start, strnlen(start, length));
+}
+
+// sizes are octal, or base-256 with the high bit of the first byte set
+uint64_t tarNumber(const char *start, size_t length)
+{
+	uint64_t value = 0;
+	if (static_cast<unsigned char>(start[0]) & 0x80)
+	{
+		value = static_cast<unsigned char>(start[0]) & 0x7f;
+		for (size_t i = 1; i < length; i++)
+			value = value << 8 | static_cast<unsigned char>(start[i]);
+		return value;
+	}
+	for (size_t i = 0; i < length && start[i]; i++)
+	{
+		if (start[i] >= '0' && start[i] <= '7')
+			value = value * 8 + (start[i] - '0');
+	}
+	return value;
+}
+
+// the path of a pax extended header, "length key=value\n" per record
+std::string paxPath(const std::string &records)
+{
+	std::string path;
+	for (size_t offset = 0; offset < records.size();)
+	{
+		size_t length = strtoul(records.c_str() + offset, nullptr, 10);
+		size_t space = records.find(' ', offset);
+		if (length == 0 || space == std::string::npos || offset + length > records.size())
+			break;
+		std::string record = records.substr(space + 1, offset + length - space - 2);
+		if (record.compare(0, 5, "path=") == 0)
+			path = record.substr(5);
+		offset += length;
+	}
+	return path;
+}
+
+std::vector<ArchiveMember> readTar(const std::string &path, const std::string &data)
+{
+	std::vector<ArchiveMember> members;
+	std::string longName;
+
+	for (size_t offset = 0; offset + BLOCK <= data.size();)
+	{
+		const char *header = data.data() + offset;
+		if (header[0] == '\0')
+			break;
+
+		uint64_t size = tarNumber(header + 124, 12);
+		char type = header[156];
+		size_t contents = offset + BLOCK;
+		if (size > data.size() - contents)
+			fail(path, "truncated member " + field(header, 100));
+		offset = contents + (size + BLOCK - 1) / BLOCK * BLOCK;
+
+		// the name of the next member
+		if (type == 'L')
+		{
+			longName = field(data.data() + contents, size);
+			continue;
+		}
+		if (type == 'x')
+		{
+			longName = paxPath(data.substr(contents, size));
+			continue;
+		}
+
+		std::string name = longName;
+		longName.clear();
+		if (name.empty())
+		{
+			std::string prefix = field(header + 345, 155);
+			name = (prefix.empty() ? "" : prefix + "/") + field(header, 100);
+		}
+		if (type == '0' || type == '\0' || type == '7')
+			members.push_back({name, data.substr(contents, size)});
+	}
+	return members;
+}
+
+uint32_t zipNumber(const std::string &data, size_t offset, size_t bytes)
+{
+	uint32_t value = 0;
+	for (size_t i = bytes; i > 0; i--)
+		value = value << 8 | static_cast<unsigned char>(data[offset + i - 1]);
+	return value;
+}
+
+// Members are found through the central directory at the end, which has
+// their sizes even where the local headers don't.
+std::vector<ArchiveMember> readZip(const std::string &path, const std::string &data)
+{
+	const size_t endSize = 22;
+	if (data.size() < endSize)
+		fail(path, "no end of central directory");
+
+	// the end record is followed by a comment of at most 65535 bytes
+	size_t end = data.size() - endSize;
+	size_t lowest = data.size() > endSize + 0xffff ? data.size() - endSize - 0xffff : 0;
+	while (data.compare(end, 4, "PK\x05\x06") != 0)
+	{
+		if (end == lowest)
+			fail(path, "no end of central directory");
+		end--;
+	}
+
+	size_t count = zipNumber(data, end + 10, 2);
+	size_t entry = zipNumber(data, end + 16, 4);
+	std::vector<ArchiveMember> members;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (entry + 46 > data.size() || data.compare(entry, 4, "PK\x01\x02") != 0)
+			fail(path, "broken central directory");
+
+		uint32_t method = zipNumber(data, entry + 10, 2);
+		uint32_t size = zipNumber(data, entry + 20, 4);
+		size_t nameLength = zipNumber(data, entry + 28, 2);
+		size_t extraLength = zipNumber(data, entry + 30, 2);
+		size_t commentLength = zipNumber(data, entry + 32, 2);
+		size_t local = zipNumber(data, entry + 42, 4);
+		if (entry + 46 + nameLength > data.size())
+			fail(path, "broken central directory");
+		std::string name = data.substr(entry + 46, nameLength);
+		entry += 46 + nameLength + extraLength + commentLength;
+
+		if (name.empty() || name.back() == '/')
+			continue;
+		if (size == 0xffffffff || local == 0xffffffff)
+			fail(path, "zip64 member " + name);
+		if (method != 0)
+		{
+			std::cerr << "Skipping the compressed member " << name << " of " << path << std::endl;
+			continue;
+		}
+
+		if (local + 30 > data.size() || data.compare(local, 4, "PK\x03\x04") != 0)
+			fail(path, "broken member " + name);
+		size_t contents = local + 30 + zipNumber(data, local + 26, 2) + zipNumber(data, local + 28, 2);
+		if (contents + size > data.size())
+			fail(path, "truncated member " + name);
+		members.push_back({name, data.substr(contents, size)});
+	}
+	return members;
+}
+
+} // namespace
+
+bool isArchive(const std::string &path)
+{
+	std::ifstream in(path, std::ios::binary);
+	std::string start(BLOCK, '\0');
+	in.read(&start[0], start.size());
+	start.resize(in.gcount());
+	return isTar(start) || isZip(start);
+}
+
+std::vector<ArchiveMember> readArchive(const std::string &path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		fail(path, "can't open it");
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	if (isTar(data))
+		return readTar(path, data);
+	if (isZip(data))
+		return readZip(path, data);
+	fail(path, "neither tar nor zip");
+}
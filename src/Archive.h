@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// a regular file inside an archive
+struct ArchiveMember
+{
+	std::string path;
+	std::string contents;
+};
+
+// whether the file at path is a tar or zip archive, by its first bytes
+bool isArchive(const std::string &path);
+
+// Reads the regular files of the tar archive (ustar, with GNU and pax long
+// names) or zip archive at path into memory, in archive order, so that they
+// can be parsed without being extracted. Only stored zip members can be read;
+// compressed ones are skipped with a warning. Exits on errors.
+std::vector<ArchiveMember> readArchive(const std::string &path);
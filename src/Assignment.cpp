@@ -0,0 +1,70 @@
+#include "Assignment.h"
+
+#include <limits>
+
+// Rows are added one at a time; each addition grows a shortest augmenting path
+// over the reduced costs of the row and column potentials u and v.
+std::vector<int> minimumCostAssignment(const std::vector<std::vector<long long>> &cost)
+{
+	const long long INF = std::numeric_limits<long long>::max() / 2;
+	int n = cost.size();
+
+	// 1-based, column 0 is where each augmenting path starts
+	std::vector<long long> u(n + 1, 0), v(n + 1, 0);
+	std::vector<int> rowOfColumn(n + 1, 0), way(n + 1, 0);
+
+	for (int row = 1; row <= n; row++)
+	{
+		rowOfColumn[0] = row;
+		int column = 0;
+		std::vector<long long> minimum(n + 1, INF);
+		std::vector<bool> used(n + 1, false);
+
+		do
+		{
+			used[column] = true;
+			int current = rowOfColumn[column];
+			long long delta = INF;
+			int next = 0;
+			for (int j = 1; j <= n; j++)
+			{
+				if (used[j])
+					continue;
+				long long reduced = cost[current - 1][j - 1] - u[current] - v[j];
+				if (reduced < minimum[j])
+				{
+					minimum[j] = reduced;
+					way[j] = column;
+				}
+				if (minimum[j] < delta)
+				{
+					delta = minimum[j];
+					next = j;
+				}
+			}
+			for (int j = 0; j <= n; j++)
+			{
+				if (used[j])
+				{
+					u[rowOfColumn[j]] += delta;
+					v[j] -= delta;
+				} else
+					minimum[j] -= delta;
+			}
+			column = next;
+		} while (rowOfColumn[column] != 0);
+
+		// flip the path
+		do
+		{
+			int previous = way[column];
+			rowOfColumn[column] = rowOfColumn[previous];
+			column = previous;
+		} while (column != 0);
+	}
+
+	std::vector<int> columnOfRow(n);
+	for (int j = 1; j <= n; j++)
+		columnOfRow[rowOfColumn[j] - 1] = j - 1;
+	return columnOfRow;
+}
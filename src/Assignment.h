@@ -0,0 +1,8 @@
+#pragma once
+
+#include <vector>
+
+// Solves the assignment problem on a square cost matrix with the Hungarian
+// method in O(n^3): returns for each row the column assigned to it, such that
+// the sum of the assigned costs is minimal.
+std::vector<int> minimumCostAssignment(const std::vector<std::vector<long long>> &cost);
@@ -0,0 +1,249 @@
+#include "AstCache.h"
+
+#include <cstdio>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace capted;
+
+namespace
+{
+
+const char magic[4] = {'C', 'S', 'A', 'T'};
+const uint32_t formatVersion = 1;
+
+bool writeU32(FILE *file, uint32_t value)
+{
+	return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+bool readU32(FILE *file, uint32_t &value)
+{
+	return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+// Counts and ids are written in 7-bit groups, low first, with the high bit set
+// on all but the last byte; most take a single byte.
+void writeVarint(FILE *file, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		fputc((value & 0x7f) | 0x80, file);
+		value >>= 7;
+	}
+	fputc(value, file);
+}
+
+bool readVarint(FILE *file, uint32_t &value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		int byte = fgetc(file);
+		if (byte == EOF)
+			return false;
+		value |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// Rebuilds a tree from its preorder, in which every node is followed by the
+// number of its children.
+Node<StringNodeData> *readTree(FILE *file)
+{
+	uint32_t labelCount;
+	if (!readVarint(file, labelCount))
+		return nullptr;
+
+	std::vector<std::string> labels(labelCount);
+	for (std::string &label : labels)
+	{
+		uint32_t length;
+		if (!readVarint(file, length))
+			return nullptr;
+		label.resize(length);
+		if (length > 0 && fread(&label[0], 1, length, file) != length)
+			return nullptr;
+	}
+
+	uint32_t nodeCount;
+	if (!readVarint(file, nodeCount) || nodeCount == 0)
+		return nullptr;
+
+	// nodes whose children are still being read, with the number left
+	std::vector<std::pair<Node<StringNodeData> *, uint32_t>> open;
+	Node<StringNodeData> *root = nullptr;
+
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		uint32_t label, children;
+		if (!readVarint(file, label) || !readVarint(file, children) || label >= labelCount)
+		{
+			delete root;
+			return nullptr;
+		}
+
+		auto *node = new Node<StringNodeData>(new StringNodeData(labels[label]));
+		if (open.empty())
+		{
+			if (root)
+			{
+				// a second root: the counts are corrupt
+				delete node;
+				delete root;
+				return nullptr;
+			}
+			root = node;
+		} else
+		{
+			open.back().first->addChild(node);
+			open.back().second--;
+		}
+
+		while (!open.empty() && open.back().second == 0)
+			open.pop_back();
+		if (children > 0)
+			open.push_back({node, children});
+	}
+
+	if (!open.empty())
+	{
+		delete root;
+		return nullptr;
+	}
+	return root;
+}
+
+void writeTree(FILE *file, Node<StringNodeData> *tree)
+{
+	std::unordered_map<std::string, uint32_t> ids;
+	std::vector<std::string> labels;
+	std::vector<std::pair<uint32_t, uint32_t>> nodes;
+
+	tree->dfs([&](Node<StringNodeData> *node, Integer) {
+		const std::string label = node->getData()->getLabel();
+		auto found = ids.find(label);
+		uint32_t id;
+		if (found == ids.end())
+		{
+			id = labels.size();
+			ids.emplace(label, id);
+			labels.push_back(label);
+		} else
+		{
+			id = found->second;
+		}
+		nodes.push_back({id, (uint32_t)node->getNumChildren()});
+	});
+
+	writeVarint(file, labels.size());
+	for (const std::string &label : labels)
+	{
+		writeVarint(file, label.size());
+		fwrite(label.data(), 1, label.size(), file);
+	}
+
+	writeVarint(file, nodes.size());
+	for (const std::pair<uint32_t, uint32_t> &node : nodes)
+	{
+		writeVarint(file, node.first);
+		writeVarint(file, node.second);
+	}
+}
+
+} // namespace
+
+uint64_t fnv1a(const std::string &data, uint64_t hash)
+{
+	for (unsigned char c : data)
+	{
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+std::string parseContext(const std::string &filename, const std::string &contents)
+{
+	bool quoted = false;
+	for (size_t position = 0; position < contents.size() && !quoted;)
+	{
+		size_t lineEnd = contents.find('\n', position);
+		if (lineEnd == std::string::npos)
+			lineEnd = contents.size();
+		size_t first = contents.find_first_not_of(" \t", position);
+		quoted = first < lineEnd && contents[first] == '#' && contents.find('"', first) < lineEnd;
+		position = lineEnd + 1;
+	}
+
+	std::string context;
+	size_t dot = filename.rfind('.');
+	size_t slash = filename.rfind('/');
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		context = filename.substr(dot);
+	if (quoted)
+		context += '\0' + (slash == std::string::npos ? std::string(".") : filename.substr(0, slash));
+	return context;
+}
+
+AstCache::AstCache(const std::string &dir, const std::string &signature)
+	: dir(dir)
+	, signatureHash(fnv1a(signature))
+{
+	mkdir(dir.c_str(), 0777);
+}
+
+std::string AstCache::path(const std::string &key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.ast", (unsigned long long)fnv1a(key, signatureHash));
+	return dir + "/" + name;
+}
+
+Node<StringNodeData> *AstCache::load(const std::string &key) const
+{
+	FILE *file = fopen(path(key).c_str(), "rb");
+	if (!file)
+		return nullptr;
+
+	char header[4];
+	uint32_t version;
+	Node<StringNodeData> *tree = nullptr;
+	if (fread(header, 1, 4, file) == 4 && std::equal(header, header + 4, magic)
+		&& readU32(file, version) && version == formatVersion)
+	{
+		tree = readTree(file);
+	}
+
+	fclose(file);
+	return tree;
+}
+
+void AstCache::store(const std::string &key, Node<StringNodeData> *tree) const
+{
+	// write a private file and rename it, so that readers never see a
+	// partial tree. Threads of one process storing the same key need
+	// files of their own too.
+	static std::atomic<unsigned> stores(0);
+	std::string target = path(key);
+	std::string temporary = target + "." + std::to_string(getpid()) + "." + std::to_string(stores++);
+
+	FILE *file = fopen(temporary.c_str(), "wb");
+	if (!file)
+		return;
+
+	fwrite(magic, 1, 4, file);
+	writeU32(file, formatVersion);
+	writeTree(file, tree);
+
+	bool written = !ferror(file);
+	if (fclose(file) == 0 && written)
+		rename(temporary.c_str(), target.c_str());
+	else
+		unlink(temporary.c_str());
+}
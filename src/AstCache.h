@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "Capted.h"
+
+// 64-bit FNV-1a hash, continuing from hash.
+uint64_t fnv1a(const std::string &data, uint64_t hash = 0xcbf29ce484222325ULL);
+
+// What besides its contents decides how a file filename is parsed: the
+// language, by the extension, and if a preprocessor directive of contents
+// quotes a string, like a quoted include, the directory it is found from.
+// Files with the same contents and context parse to the same tree.
+std::string parseContext(const std::string &filename, const std::string &contents);
+
+// A directory of trees built from source files, so that unchanged files are
+// not parsed again. A tree is found by the hash of the file contents and of a
+// signature of everything else the tree depends on (parser version and
+// arguments). Trees are stored in preorder, with each label spelled once.
+class AstCache
+{
+public:
+	AstCache(const std::string &dir, const std::string &signature);
+
+	// Trees are found by the contents they were built from, or by any other
+	// key that identifies the contents, like a git blob id. Returns nullptr if
+	// there is no tree for the key.
+	capted::Node<capted::StringNodeData> *load(const std::string &key) const;
+	void store(const std::string &key, capted::Node<capted::StringNodeData> *tree) const;
+
+private:
+	std::string dir;
+	uint64_t signatureHash;
+
+	std::string path(const std::string &key) const;
+};
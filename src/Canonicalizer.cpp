@@ -0,0 +1,103 @@
+#include "Canonicalizer.h"
+
+#include <iterator>
+#include <sstream>
+
+using namespace capted;
+
+Canonicalizer::Canonicalizer(const std::string &kinds)
+	: nodes(0)
+	, removed(0)
+{
+	std::istringstream list(kinds);
+	for (std::string kind; std::getline(list, kind, ',');)
+	{
+		if (!kind.empty())
+			droppedKinds.insert(kind);
+	}
+}
+
+void Canonicalizer::canonicalize(Tree *tree, std::vector<bool> *kept)
+{
+	std::unordered_map<Tree *, size_t> preorder;
+	size_t size = 0;
+	if (kept)
+	{
+		tree->dfs([&preorder](Tree *node, Integer) {
+			preorder.emplace(node, preorder.size());
+		});
+		size = preorder.size();
+		kept->assign(size, true);
+	} else
+	{
+		size = tree->getNodeCount();
+	}
+
+	uint64_t count = 0;
+	rewrite(tree, preorder, kept, count);
+	nodes += size;
+	removed += count;
+}
+
+std::string Canonicalizer::getSignature() const
+{
+	std::string signature = "canonical";
+	for (const std::string &kind : droppedKinds)
+		signature += "," + kind;
+	return signature;
+}
+
+uint64_t Canonicalizer::getNodes() const
+{
+	return nodes;
+}
+
+uint64_t Canonicalizer::getRemoved() const
+{
+	return removed;
+}
+
+bool Canonicalizer::isRemovable(Tree *parent, Tree *child) const
+{
+	std::string kind = child->getData()->getLabel();
+	if (droppedKinds.count(kind))
+		return true;
+	if (kind == "CompoundStmt" && parent->getData()->getLabel() == kind)
+		return true;
+	return child->getNumChildren() == 1 && child->getChildren().front()->getData()->getLabel() == kind;
+}
+
+void Canonicalizer::rewrite(Tree *node, const std::unordered_map<Tree *, size_t> &preorder, std::vector<bool> *kept, uint64_t &count)
+{
+	for (Tree *child : node->getChildren())
+		rewrite(child, preorder, kept, count);
+
+	// the children of a removed node are checked in turn, since they may be
+	// removable below their new parent
+	std::list<Tree *> &children = node->getChildren();
+	for (auto it = children.begin(); it != children.end();)
+	{
+		Tree *child = *it;
+		if (!isRemovable(node, child))
+		{
+			it++;
+			continue;
+		}
+
+		std::list<Tree *> &grandchildren = child->getChildren();
+		long moved = grandchildren.size();
+		while (!grandchildren.empty())
+		{
+			Tree *grandchild = grandchildren.front();
+			grandchild->detachFromParent();
+			node->insertChild(it, grandchild);
+		}
+
+		if (kept)
+			(*kept)[preorder.at(child)] = false;
+		count++;
+		it = children.erase(it);
+		delete child;
+		std::advance(it, -moved);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+
+#include "Capted.h"
+
+// Removes AST nodes that carry little structure, so that trees are smaller
+// when they are compared; the cost of APTED grows faster than the tree sizes.
+// Removed are
+//   - nodes of the dropped kinds, UnexposedExpr by default, which libclang
+//     makes of implicit casts and other expressions it does not expose,
+//   - a CompoundStmt right below a CompoundStmt, i.e. a nested block,
+//   - the upper node of two of the same kind where it is the only child,
+//     like nested parentheses.
+// The children of a removed node take its place among its parent's children.
+// The root is never removed.
+class Canonicalizer
+{
+public:
+	typedef capted::Node<capted::StringNodeData> Tree;
+
+	// droppedKinds is a comma-separated list of cursor kind spellings
+	explicit Canonicalizer(const std::string &droppedKinds = "UnexposedExpr");
+
+	Canonicalizer(const Canonicalizer &) = delete;
+	Canonicalizer &operator=(const Canonicalizer &) = delete;
+
+	// Rewrites the tree in place. If kept is given, it receives for every node
+	// of the tree as it was, in preorder, whether the node is still there.
+	// Can be called from several threads at once.
+	void canonicalize(Tree *tree, std::vector<bool> *kept = nullptr);
+
+	// tells configurations apart, e.g. in the signature of cached trees
+	std::string getSignature() const;
+
+	// nodes of all trees before canonicalization, and the ones removed
+	uint64_t getNodes() const;
+	uint64_t getRemoved() const;
+
+private:
+	std::set<std::string> droppedKinds;
+	std::atomic<uint64_t> nodes;
+	std::atomic<uint64_t> removed;
+
+	bool isRemovable(Tree *parent, Tree *child) const;
+	// preorder gives the original preorder positions if kept is given
+	void rewrite(Tree *node, const std::unordered_map<Tree *, size_t> &preorder, std::vector<bool> *kept, uint64_t &count);
+};
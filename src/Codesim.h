@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include "Capted.h"
+#include "CorpusIndex.h"
+
+class AstCache;
+
+// What the modes in src share with codesim.cpp, which defines all of it: the
+// options, parsing, and the files of corpora and how they are compared.
+
+extern bool verbose;
+
+// trees of files parsed before, if enabled
+extern AstCache *astCache;
+
+// threads that parse the files of a corpus, and compare them
+extern long parseThreads;
+
+// keeps the output of threads apart
+extern std::mutex outputMutex;
+
+// compare files function by function, see functionSimilarity. The files of
+// corpora are kept as trees then.
+extern bool functionLevel;
+
+// kind and source extent of an AST node, collected in preorder to look up the
+// nodes of an edit mapping
+struct NodeSource
+{
+	std::string kind;
+	unsigned startLine, startColumn;
+	unsigned endLine, endColumn;
+};
+
+// Parsing. Trees are null for files that don't parse; failParse reports one
+// and exits.
+capted::Node<capted::StringNodeData> *parseContents(const std::string &filename, const std::string &contents, const std::string &cacheKey,
+													std::vector<NodeSource> *sources = nullptr);
+capted::Node<capted::StringNodeData> *parseTree(const std::string &filename, std::vector<NodeSource> *sources = nullptr);
+void failParse(const std::string &filename);
+std::string readFile(const std::string &filename);
+std::vector<std::string> tokenizeFile(const std::string &filename);
+
+// the sources of corpora, and their trees
+bool isSourceFile(const std::string &name);
+std::vector<std::string> listCorpus(const std::string &dir);
+std::vector<capted::Node<capted::StringNodeData> *> parseFiles(const std::vector<std::string> &files);
+
+capted::Integer computeEditDistance(capted::Node<capted::StringNodeData> *t1, capted::Node<capted::StringNodeData> *t2);
+
+// a file of a corpus with what the distance filters need. Files of an index
+// have no tree, only their position in it, and are compared through views of
+// their indexers. Files of a loaded corpus keep their tree in the tree store
+// instead.
+struct CorpusFile
+{
+	std::string path;
+	capted::Node<capted::StringNodeData> *tree;
+	capted::TreeProfile<capted::StringNodeData> profile;
+	capted::DagNode *dag;
+	int64_t indexEntry;
+};
+
+CorpusFile makeCorpusFile(const std::string &path, capted::Node<capted::StringNodeData> *tree,
+						  capted::LabelDictionary<capted::StringNodeData> &labels);
+CorpusFile storeCorpusFile(const std::string &path, capted::Node<capted::StringNodeData> *tree,
+						   capted::LabelDictionary<capted::StringNodeData> &labels);
+std::vector<CorpusFile> loadCorpus(const std::string &path, capted::LabelDictionary<capted::StringNodeData> &labels);
+void releaseCorpusFile(CorpusFile &file);
+void releaseCorpus(std::vector<CorpusFile> &corpus);
+
+// The indexers of a file that is not in an index, at the index types of the
+// pairs it is part of. A file compared with many others, like a query, keeps
+// them, so that it is indexed once per type rather than once per pair.
+struct FileIndexers
+{
+	std::unique_ptr<capted::NodeIndexer<capted::StringNodeData, int16_t, int16_t>> int16;
+	std::unique_ptr<capted::NodeIndexer<capted::StringNodeData, int32_t, int32_t>> int32;
+	std::unique_ptr<capted::NodeIndexer<capted::StringNodeData, int64_t, int64_t>> int64;
+
+	std::unique_ptr<capted::NodeIndexer<capted::StringNodeData, int16_t, int16_t>> &get(int16_t)
+	{
+		return int16;
+	}
+
+	std::unique_ptr<capted::NodeIndexer<capted::StringNodeData, int32_t, int32_t>> &get(int32_t)
+	{
+		return int32;
+	}
+
+	std::unique_ptr<capted::NodeIndexer<capted::StringNodeData, int64_t, int64_t>> &get(int64_t)
+	{
+		return int64;
+	}
+};
+
+CorpusIndex::Indexer *indexSmallCorpusFile(const CorpusFile &file, capted::LabelDictionary<capted::StringNodeData> &labels);
+
+// Pairs of one small file, the query, with small files that passed the
+// bounds, compared sixteen at a time with BatchedDistance. Query and
+// candidates are labeled indexers of one dictionary; each thread keeps a
+// batch of its own.
+struct SmallPairBatch
+{
+	static const size_t lanes = 16;
+	capted::BatchedDistance<capted::StringNodeData, capted::Integer, capted::Integer> batched;
+	CorpusIndex::Indexer *query = nullptr;
+	std::vector<CorpusIndex::Indexer *> candidates;
+	std::vector<size_t> tags;
+
+	// queues a candidate, known by tag; once the batch is full, it is
+	// computed and report(tag, distance) gets each pair
+	template<class Report>
+	void add(CorpusIndex::Indexer *candidate, size_t tag, Report report)
+	{
+		candidates.push_back(candidate);
+		tags.push_back(tag);
+		if (candidates.size() == lanes)
+			compute(report);
+	}
+
+	// computes the queued pairs; before the query changes
+	template<class Report>
+	void compute(Report report)
+	{
+		if (candidates.empty())
+			return;
+		std::vector<capted::Integer> distances = batched.computeEditDistances(query, candidates);
+		for (size_t c = 0; c < distances.size(); c++)
+			report(tags[c], distances[c]);
+		candidates.clear();
+		tags.clear();
+	}
+};
+
+// distances and similarities of files
+capted::Integer computeEditDistance(const CorpusFile &a, const CorpusFile &b, FileIndexers *indexersA = nullptr);
+float unitCostSimilarity(capted::Integer distance, capted::Integer size1, capted::Integer size2);
+capted::Integer distanceBudget(float similarity, capted::Integer size1, capted::Integer size2);
+bool sizesCanMatch(capted::Integer size1, capted::Integer size2, float minSimilarity, capted::Integer &budget);
+float fileSimilarity(const CorpusFile &a, const CorpusFile &b, FileIndexers *indexersA = nullptr, long threadCount = parseThreads);
+std::vector<std::pair<float, size_t>> findTopK(const CorpusFile &queryFile, const std::vector<CorpusFile> &corpus, size_t k,
+											   capted::LabelDictionary<capted::StringNodeData> &labels);
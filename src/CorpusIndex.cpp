@@ -0,0 +1,263 @@
+#include "CorpusIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace capted;
+
+// Layout: header, entries, then per file the indexer arena followed by the
+// label bag, preorder and postorder, then the paths, then the labels as
+// (length, bytes). Arenas start on ALIGNMENT boundaries, as their arrays
+// expect.
+struct CorpusIndex::Header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t indexSize;
+	uint32_t costSize;
+	uint64_t fileCount;
+	uint64_t labelCount;
+	uint64_t labelsOffset;
+};
+
+struct CorpusIndex::Entry
+{
+	uint64_t arenaOffset;
+	uint64_t profileOffset;
+	uint64_t pathOffset;
+	uint32_t pathLength;
+	int32_t size;
+	int32_t lchl;
+	int32_t rchl;
+};
+
+namespace
+{
+
+const char magic[4] = {'C', 'S', 'I', 'X'};
+const uint32_t formatVersion = 2;
+const uint64_t ALIGNMENT = 64;
+
+uint64_t align(uint64_t offset)
+{
+	return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// whether size bytes at offset lie within a mapping of length bytes
+bool within(uint64_t offset, uint64_t size, uint64_t length)
+{
+	return offset <= length && size <= length - offset;
+}
+
+// writes data at offset, padding the file with zeros up to it
+bool writeAt(FILE *file, uint64_t &position, uint64_t offset, const void *data, size_t size)
+{
+	static const char zeros[ALIGNMENT] = {};
+	while (position < offset)
+	{
+		size_t padding = std::min<uint64_t>(offset - position, ALIGNMENT);
+		if (fwrite(zeros, 1, padding, file) != padding)
+			return false;
+		position += padding;
+	}
+	if (size > 0 && fwrite(data, 1, size, file) != size)
+		return false;
+	position += size;
+	return true;
+}
+
+} // namespace
+
+bool CorpusIndex::write(const std::string &path, const std::vector<std::string> &files,
+						const std::vector<Node<StringNodeData> *> &trees)
+{
+	LabelDictionary<StringNodeData> labels;
+	BasicStringCostModel<Integer> costModel;
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+
+	Header header = {};
+	std::copy(magic, magic + 4, header.magic);
+	header.version = formatVersion;
+	header.indexSize = sizeof(Integer);
+	header.costSize = sizeof(Integer);
+	header.fileCount = trees.size();
+
+	std::vector<Entry> entries(trees.size());
+	uint64_t position = 0;
+	uint64_t offset = align(sizeof(Header) + entries.size() * sizeof(Entry));
+	bool ok = writeAt(file, position, 0, &header, sizeof(header))
+		   && writeAt(file, position, sizeof(Header), entries.data(), entries.size() * sizeof(Entry));
+
+	for (size_t i = 0; ok && i < trees.size(); i++)
+	{
+		Indexer indexer(trees[i], &costModel, &labels);
+		TreeProfile<StringNodeData> profile(trees[i], labels);
+		Entry &entry = entries[i];
+		entry.size = indexer.getSize();
+		entry.lchl = indexer.getLchl();
+		entry.rchl = indexer.getRchl();
+
+		entry.arenaOffset = offset;
+		ok = writeAt(file, position, offset, indexer.getArena(), indexer.getArenaSize());
+		offset = align(position);
+
+		entry.profileOffset = offset;
+		size_t bytes = entry.size * sizeof(int32_t);
+		ok = ok && writeAt(file, position, offset, profile.labelBag, bytes)
+				&& writeAt(file, position, position, profile.preorder, bytes)
+				&& writeAt(file, position, position, profile.postorder, bytes);
+		offset = align(position);
+	}
+
+	for (size_t i = 0; ok && i < files.size(); i++)
+	{
+		entries[i].pathOffset = position;
+		entries[i].pathLength = files[i].size();
+		ok = writeAt(file, position, position, files[i].data(), files[i].size());
+	}
+
+	header.labelCount = labels.size();
+	header.labelsOffset = position;
+	for (int32_t id = 0; ok && id < labels.size(); id++)
+	{
+		const std::string &label = labels.getLabel(id);
+		uint32_t labelLength = label.size();
+		ok = writeAt(file, position, position, &labelLength, sizeof(labelLength))
+		  && writeAt(file, position, position, label.data(), label.size());
+	}
+
+	// the header and the entries are complete now
+	ok = ok && fseek(file, 0, SEEK_SET) == 0
+			&& fwrite(&header, sizeof(header), 1, file) == 1
+			&& (entries.empty() || fwrite(entries.data(), sizeof(Entry), entries.size(), file) == entries.size());
+
+	return fclose(file) == 0 && ok;
+}
+
+CorpusIndex::CorpusIndex(const std::string &path, LabelDictionary<StringNodeData> &labels)
+	: labels(labels)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0)
+	{
+		std::cerr << "Can't open the index: " << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	length = info.st_size;
+
+	// private and writable: the indexers are not const, though APTED only
+	// reads them
+	void *mapping = length >= sizeof(Header) ? mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "Can't map the index: " << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	base = static_cast<char *>(mapping);
+	header = reinterpret_cast<const Header *>(base);
+	entries = reinterpret_cast<const Entry *>(base + sizeof(Header));
+
+	if (!std::equal(magic, magic + 4, header->magic) || header->version != formatVersion
+		|| header->indexSize != sizeof(Integer) || header->costSize != sizeof(Integer)
+		|| header->fileCount > (length - sizeof(Header)) / sizeof(Entry) || header->labelsOffset > length)
+	{
+		std::cerr << "Not a compatible index: " << path << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (labels.size() != 0)
+	{
+		std::cerr << "Only one corpus can be an index" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// a truncated or corrupt file must not make anything read past the mapping
+	for (uint64_t i = 0; i < header->fileCount; i++)
+	{
+		const Entry &entry = entries[i];
+		uint64_t sequences = 3 * (uint64_t)std::max(entry.size, 0) * sizeof(int32_t);
+		if (entry.size <= 0 || entry.arenaOffset % ALIGNMENT != 0 || entry.profileOffset % ALIGNMENT != 0
+			|| !within(entry.arenaOffset, Indexer::getArenaSize(entry.size, &labels), length)
+			|| !within(entry.profileOffset, sequences, length)
+			|| !within(entry.pathOffset, entry.pathLength, length))
+		{
+			std::cerr << "Corrupt index: " << path << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	uint64_t offset = header->labelsOffset;
+	for (uint64_t id = 0; id < header->labelCount; id++)
+	{
+		uint32_t labelLength;
+		if (!within(offset, sizeof(labelLength), length))
+		{
+			std::cerr << "Corrupt index: " << path << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		memcpy(&labelLength, base + offset, sizeof(labelLength));
+		offset += sizeof(labelLength);
+		if (!within(offset, labelLength, length))
+		{
+			std::cerr << "Corrupt index: " << path << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		labels.intern(std::string(base + offset, labelLength));
+		offset += labelLength;
+	}
+}
+
+CorpusIndex::~CorpusIndex()
+{
+	munmap(base, length);
+}
+
+size_t CorpusIndex::size() const
+{
+	return header->fileCount;
+}
+
+std::string CorpusIndex::getPath(size_t file) const
+{
+	return std::string(base + entries[file].pathOffset, entries[file].pathLength);
+}
+
+TreeProfile<StringNodeData> CorpusIndex::getProfile(size_t file) const
+{
+	const Entry &entry = entries[file];
+	const int32_t *sequences = reinterpret_cast<const int32_t *>(base + entry.profileOffset);
+	return TreeProfile<StringNodeData>(entry.size, sequences, sequences + entry.size, sequences + 2 * entry.size);
+}
+
+CorpusIndex::Indexer *CorpusIndex::getIndexer(size_t file) const
+{
+	const Entry &entry = entries[file];
+	return new Indexer(base + entry.arenaOffset, entry.size, entry.lchl, entry.rchl, &labels);
+}
+
+bool CorpusIndex::isIndexFile(const std::string &path)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+		return false;
+
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	char fileMagic[4];
+	uint32_t version;
+	bool read = fread(fileMagic, sizeof(fileMagic), 1, file) == 1 && fread(&version, sizeof(version), 1, file) == 1;
+	fclose(file);
+	return read && std::equal(magic, magic + 4, fileMagic) && version == formatVersion;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Capted.h"
+
+// A corpus of parsed files in a single file: for every file its path, the
+// arena of its labeled NodeIndexer and its TreeProfile, plus the labels. The
+// file is memory-mapped, and indexers and profiles are views of it, so opening
+// a corpus takes no parsing, indexing or deserialization.
+//
+// The indexers are built with unit costs (BasicStringCostModel<Integer>), which
+// is what their cost sums are valid for.
+class CorpusIndex
+{
+public:
+	typedef capted::NodeIndexer<capted::StringNodeData, capted::Integer, capted::Integer> Indexer;
+
+	// Writes the trees with their paths to an index file at path. Returns
+	// false on write errors.
+	static bool write(const std::string &path, const std::vector<std::string> &files,
+					  const std::vector<capted::Node<capted::StringNodeData> *> &trees);
+
+	// Maps the index file at path and interns its labels into labels, which
+	// has to be empty, so that the ids in the file are valid. Exits on errors,
+	// including entries that reach past the end of the file.
+	CorpusIndex(const std::string &path, capted::LabelDictionary<capted::StringNodeData> &labels);
+	~CorpusIndex();
+
+	CorpusIndex(const CorpusIndex &) = delete;
+	CorpusIndex &operator=(const CorpusIndex &) = delete;
+
+	size_t size() const;
+	std::string getPath(size_t file) const;
+	capted::TreeProfile<capted::StringNodeData> getProfile(size_t file) const;
+
+	// a view of the indexer of a file, to be deleted by the caller; it takes
+	// constant time, so views can be made for each comparison
+	Indexer *getIndexer(size_t file) const;
+
+	// true if path names a file that starts like an index of this version,
+	// rather than a directory, an archive or anything else
+	static bool isIndexFile(const std::string &path);
+
+private:
+	struct Header;
+	struct Entry;
+
+	char *base;
+	size_t length;
+	const Header *header;
+	const Entry *entries;
+	capted::LabelDictionary<capted::StringNodeData> &labels;
+};
@@ -0,0 +1,109 @@
+#include "DirectoryWatcher.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+namespace
+{
+
+const uint32_t EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF;
+
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(const std::string &dir)
+	: fd(inotify_init1(IN_CLOEXEC))
+{
+	if (fd < 0)
+	{
+		std::cerr << "Can't watch the directory: " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	watch(dir, nullptr);
+	if (directories.empty())
+	{
+		std::cerr << "Can't watch the directory: " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	close(fd);
+}
+
+// watches dir and the directories below it, and appends the files in them to
+// existing if given
+void DirectoryWatcher::watch(const std::string &dir, std::vector<Change> *existing)
+{
+	int descriptor = inotify_add_watch(fd, dir.c_str(), EVENTS);
+	if (descriptor < 0)
+		return;
+	directories[descriptor] = dir;
+
+	DIR *handle = opendir(dir.c_str());
+	if (!handle)
+		return;
+
+	while (struct dirent *entry = readdir(handle))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string path = dir + "/" + name;
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			continue;
+
+		if (S_ISDIR(info.st_mode))
+			watch(path, existing);
+		else if (existing && S_ISREG(info.st_mode))
+			existing->push_back({Change::WRITTEN, path, false});
+	}
+	closedir(handle);
+}
+
+bool DirectoryWatcher::wait(std::vector<Change> &changes)
+{
+	alignas(inotify_event) char buffer[64 * 1024];
+	ssize_t length;
+	do
+	{
+		length = read(fd, buffer, sizeof(buffer));
+	} while (length < 0 && errno == EINTR);
+	if (length <= 0)
+		return false;
+
+	for (char *position = buffer; position < buffer + length;)
+	{
+		inotify_event *event = reinterpret_cast<inotify_event *>(position);
+		position += sizeof(inotify_event) + event->len;
+
+		auto found = directories.find(event->wd);
+		if (found == directories.end())
+			continue;
+		if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+		{
+			directories.erase(found);
+			continue;
+		}
+		if (event->len == 0)
+			continue;
+
+		std::string path = found->second + "/" + event->name;
+		bool directory = event->mask & IN_ISDIR;
+
+		if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			changes.push_back({Change::REMOVED, path, directory});
+		else if (directory && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+			watch(path, &changes);
+		else if (!directory && (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))
+			changes.push_back({Change::WRITTEN, path, false});
+	}
+	return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Reports changes below a directory through inotify, including directories
+// created after the start.
+class DirectoryWatcher
+{
+public:
+	struct Change
+	{
+		enum Kind
+		{
+			WRITTEN, // created, written or moved in
+			REMOVED, // deleted or moved out
+		};
+
+		Kind kind;
+		std::string path;
+		bool directory;
+	};
+
+	// exits if dir can't be watched
+	explicit DirectoryWatcher(const std::string &dir);
+	~DirectoryWatcher();
+
+	DirectoryWatcher(const DirectoryWatcher &) = delete;
+	DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+	// Waits for the next changes and appends them. A directory that appears
+	// is reported with the files already in it, as these may have been
+	// written before it was watched. Returns false on errors.
+	bool wait(std::vector<Change> &changes);
+
+private:
+	int fd;
+	std::unordered_map<int, std::string> directories;
+
+	void watch(const std::string &dir, std::vector<Change> *existing);
+};
@@ -0,0 +1,68 @@
+#include "Fingerprint.h"
+
+#include <algorithm>
+
+#include "AstCache.h"
+
+std::vector<uint64_t> winnowFingerprints(const std::vector<std::string> &tokens, size_t k, size_t window)
+{
+	std::vector<uint64_t> tokenHashes;
+	for (const std::string &token : tokens)
+		tokenHashes.push_back(fnv1a(token));
+
+	// a sequence shorter than k is a single k-gram
+	std::vector<uint64_t> grams;
+	size_t gramLength = std::min(k, tokenHashes.size());
+	for (size_t i = 0; gramLength > 0 && i + gramLength <= tokenHashes.size(); i++)
+	{
+		uint64_t hash = 0;
+		for (size_t j = i; j < i + gramLength; j++)
+			hash = hash * 0x100000001b3ULL + tokenHashes[j];
+		grams.push_back(hash);
+	}
+
+	// the rightmost minimum of each window, once per position
+	std::vector<uint64_t> fingerprints;
+	size_t windowLength = std::min(std::max<size_t>(window, 1), grams.size());
+	size_t selected = grams.size();
+	for (size_t i = 0; windowLength > 0 && i + windowLength <= grams.size(); i++)
+	{
+		size_t minimum = i;
+		for (size_t j = i + 1; j < i + windowLength; j++)
+		{
+			if (grams[j] <= grams[minimum])
+				minimum = j;
+		}
+		if (minimum != selected)
+		{
+			fingerprints.push_back(grams[minimum]);
+			selected = minimum;
+		}
+	}
+
+	std::sort(fingerprints.begin(), fingerprints.end());
+	fingerprints.erase(std::unique(fingerprints.begin(), fingerprints.end()), fingerprints.end());
+	return fingerprints;
+}
+
+double fingerprintOverlap(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+	if (a.empty() || b.empty())
+		return 0;
+
+	size_t common = 0;
+	for (size_t i = 0, j = 0; i < a.size() && j < b.size();)
+	{
+		if (a[i] < b[j])
+			i++;
+		else if (b[j] < a[i])
+			j++;
+		else
+		{
+			common++;
+			i++;
+			j++;
+		}
+	}
+	return (double)common / std::min(a.size(), b.size());
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Fingerprints of a token sequence by winnowing [1]: every k-gram of tokens is
+// hashed, and of each window of consecutive k-gram hashes the minimum is kept.
+// Any run of at least k + window - 1 tokens that two sequences share yields a
+// fingerprint they share, while far fewer fingerprints are kept than there
+// are k-grams. Returns the distinct fingerprints, sorted.
+//
+// [1] S. Schleimer, D. S. Wilkerson and A. Aiken. Winnowing: local algorithms
+//     for document fingerprinting. SIGMOD 2003.
+std::vector<uint64_t> winnowFingerprints(const std::vector<std::string> &tokens, size_t k = 5, size_t window = 4);
+
+// the share of the fingerprints of the smaller set that the other one has too,
+// 0 if either is empty
+double fingerprintOverlap(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b);
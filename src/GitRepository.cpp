@@ -0,0 +1,145 @@
+#include "GitRepository.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace
+{
+
+// Starts git with arguments in dir, with pipes to its standard input (unless
+// input is nullptr) and from its standard output. Arguments are not seen by a
+// shell, so revisions need no quoting.
+pid_t startGit(const std::string &dir, std::vector<std::string> arguments, FILE **input, FILE **output)
+{
+	int toChild[2], fromChild[2];
+	if (pipe(toChild) != 0 || pipe(fromChild) != 0)
+		return -1;
+
+	arguments.insert(arguments.begin(), {"git", "-C", dir});
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		dup2(toChild[0], STDIN_FILENO);
+		dup2(fromChild[1], STDOUT_FILENO);
+		close(toChild[0]);
+		close(toChild[1]);
+		close(fromChild[0]);
+		close(fromChild[1]);
+
+		std::vector<char *> argv;
+		for (std::string &argument : arguments)
+			argv.push_back(&argument[0]);
+		argv.push_back(nullptr);
+		execvp("git", argv.data());
+		_exit(127);
+	}
+
+	close(toChild[0]);
+	close(fromChild[1]);
+	if (input)
+		*input = fdopen(toChild[1], "w");
+	else
+		close(toChild[1]);
+	*output = fdopen(fromChild[0], "r");
+	return pid;
+}
+
+bool succeeded(pid_t pid)
+{
+	int status;
+	return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+GitRepository::GitRepository(const std::string &dir)
+	: dir(dir), catFile(-1), requests(nullptr), responses(nullptr)
+{
+}
+
+GitRepository::~GitRepository()
+{
+	if (catFile > 0)
+	{
+		fclose(requests);
+		fclose(responses);
+		succeeded(catFile);
+	}
+}
+
+std::vector<GitRepository::File> GitRepository::listFiles(const std::string &revision)
+{
+	FILE *output;
+	pid_t pid = startGit(dir, {"ls-tree", "-r", "-z", "--full-tree", revision}, nullptr, &output);
+	if (pid < 0)
+	{
+		std::cerr << "Can't run git in " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// "<mode> <type> <blob>\t<path>\0" per file
+	std::vector<File> files;
+	std::string entry;
+	for (int c; (c = fgetc(output)) != EOF;)
+	{
+		if (c != '\0')
+		{
+			entry += c;
+			continue;
+		}
+
+		size_t tab = entry.find('\t');
+		size_t space = entry.find(' ');
+		if (tab != std::string::npos && space != std::string::npos && entry.compare(space + 1, 5, "blob ") == 0
+			&& entry.compare(0, 3, "120") != 0)
+		{
+			files.push_back({entry.substr(tab + 1), entry.substr(space + 6, tab - space - 6)});
+		}
+		entry.clear();
+	}
+	fclose(output);
+
+	if (!succeeded(pid))
+	{
+		std::cerr << "Can't list the files of revision " << revision << " in " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return files;
+}
+
+std::string GitRepository::readBlob(const std::string &blob)
+{
+	if (catFile < 0)
+	{
+		catFile = startGit(dir, {"cat-file", "--batch"}, &requests, &responses);
+		if (catFile < 0)
+		{
+			std::cerr << "Can't run git in " << dir << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fprintf(requests, "%s\n", blob.c_str());
+	fflush(requests);
+
+	// "<blob> blob <size>\n<contents>\n", or "<blob> missing\n"
+	char header[256];
+	char type[32];
+	unsigned long size;
+	if (!fgets(header, sizeof(header), responses) || sscanf(header, "%*s %31s %lu", type, &size) != 2
+		|| std::string(type) != "blob")
+	{
+		std::cerr << "Can't read blob " << blob << " in " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	std::string contents(size, '\0');
+	if ((size > 0 && fread(&contents[0], 1, size, responses) != size) || fgetc(responses) != '\n')
+	{
+		std::cerr << "Can't read blob " << blob << " in " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return contents;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <sys/types.h>
+
+// Reads revisions of a local git repository through the git command, without
+// a working tree: files are listed with ls-tree and read with cat-file.
+class GitRepository
+{
+public:
+	// a file of a revision and the id of its contents
+	struct File
+	{
+		std::string path;
+		std::string blob;
+	};
+
+	explicit GitRepository(const std::string &dir);
+	~GitRepository();
+
+	GitRepository(const GitRepository &) = delete;
+	GitRepository &operator=(const GitRepository &) = delete;
+
+	// the regular files of a revision, sorted by path; exits on errors
+	std::vector<File> listFiles(const std::string &revision);
+
+	// the contents of a blob; exits on errors. All blobs are read through one
+	// cat-file --batch process, started with the first.
+	std::string readBlob(const std::string &blob);
+
+private:
+	std::string dir;
+	pid_t catFile;
+	FILE *requests;
+	FILE *responses;
+};
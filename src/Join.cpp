@@ -0,0 +1,409 @@
+#include "Join.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "ConcurrentQueue.h"
+#include "ParsePool.h"
+#include "StageCounter.h"
+#include "Fingerprint.h"
+
+using namespace capted;
+
+namespace
+{
+
+// the sizes a size is joined with from below
+Integer lowestJoinSize(Integer size, float minSimilarity)
+{
+	// n2 >= n1 - budget means n2 >= n1 * s / (2 - s); start a little below
+	return std::floor(size * minSimilarity / (2 - minSimilarity)) - 1;
+}
+
+// prints the pair of a file of A and a file of B if they are similar enough
+void printJoinPair(const CorpusFile &a, const CorpusFile &b, float similarity, float minSimilarity, JoinStats &stats)
+{
+	if (similarity < minSimilarity)
+		return;
+
+	stats.matches++;
+	std::lock_guard<std::mutex> lock(outputMutex);
+	std::cout << similarity << "\t" << a.path << "\t" << b.path << "\n";
+}
+
+// a file of a pipelined join and the files of the other side that are ready
+// and in its size range, by their positions in the corpus
+struct JoinTask
+{
+	size_t file;
+	std::vector<size_t> others;
+};
+
+} // namespace
+
+bool withinBounds(const CorpusFile &a, const CorpusFile &b, Integer budget, JoinStats &stats)
+{
+	if (functionLevel)
+		return true;
+	if (labelBagLowerBound(a.profile, b.profile) > budget)
+	{
+		stats.bagPruned++;
+		return false;
+	}
+	if (traversalLowerBound(a.profile, b.profile, budget) > budget)
+	{
+		stats.traversalPruned++;
+		return false;
+	}
+	return true;
+}
+
+float boundedSimilarity(const CorpusFile &a, const CorpusFile &b, float minSimilarity, Integer budget, JoinStats &stats)
+{
+	if (!withinBounds(a, b, budget, stats))
+		return -1;
+
+	stats.computed++;
+	float similarity = unitCostSimilarity(computeEditDistance(a, b), a.profile.size, b.profile.size);
+	if (similarity < minSimilarity)
+		return -1;
+
+	stats.matches++;
+	return similarity;
+}
+
+std::vector<std::unique_ptr<CorpusIndex::Indexer>> indexSmallCorpus(const std::vector<CorpusFile> &corpus,
+																	 LabelDictionary<StringNodeData> &labels)
+{
+	std::vector<std::unique_ptr<CorpusIndex::Indexer>> indexers;
+	for (const CorpusFile &file : corpus)
+		indexers.emplace_back(indexSmallCorpusFile(file, labels));
+	return indexers;
+}
+
+void joinCorpora(const std::string &dirA, const std::string &dirB, float minSimilarity)
+{
+	LabelDictionary<StringNodeData> labels;
+	std::vector<CorpusFile> corpusA, corpusB;
+	if (CorpusIndex::isIndexFile(dirB))
+	{
+		corpusB = loadCorpus(dirB, labels);
+		corpusA = loadCorpus(dirA, labels);
+	} else
+	{
+		corpusA = loadCorpus(dirA, labels);
+		corpusB = loadCorpus(dirB, labels);
+	}
+
+	std::stable_sort(corpusB.begin(), corpusB.end(), [](const CorpusFile &a, const CorpusFile &b) {
+		return a.profile.size < b.profile.size;
+	});
+	std::vector<std::unique_ptr<CorpusIndex::Indexer>> smallA = indexSmallCorpus(corpusA, labels);
+	std::vector<std::unique_ptr<CorpusIndex::Indexer>> smallB = indexSmallCorpus(corpusB, labels);
+
+	JoinStats stats;
+	RowComparer row(stats);
+
+	for (size_t i = 0; i < corpusA.size(); i++)
+	{
+		const CorpusFile &a = corpusA[i];
+		row.start(a, smallA[i].get());
+		auto found = [&](size_t b, float similarity) {
+			printJoinPair(a, corpusB[b], similarity, minSimilarity, stats);
+		};
+
+		Integer size1 = a.profile.size;
+		auto first = std::lower_bound(corpusB.begin(), corpusB.end(), lowestJoinSize(size1, minSimilarity), [](const CorpusFile &b, Integer size) {
+			return b.profile.size < size;
+		});
+
+		for (size_t j = first - corpusB.begin(); j < corpusB.size(); j++)
+		{
+			const CorpusFile &b = corpusB[j];
+			Integer budget;
+			if (!sizesCanMatch(size1, b.profile.size, minSimilarity, budget))
+			{
+				// the rest of B is larger still
+				if (b.profile.size > size1)
+					break;
+				continue;
+			}
+			stats.sizePairs++;
+
+			if (withinBounds(a, b, budget, stats))
+				row.compare(b, smallB[j].get(), j, found);
+		}
+		row.finish(found);
+	}
+
+	if (verbose)
+		stats.print(corpusA.size() * corpusB.size());
+
+	releaseCorpus(corpusA);
+	releaseCorpus(corpusB);
+}
+
+void joinCorporaPipelined(const std::string &dirA, const std::string &dirB, float minSimilarity)
+{
+	typedef StageCounter::Clock Clock;
+	std::vector<std::string> files = listCorpus(dirA);
+	size_t sizeA = files.size();
+	std::vector<std::string> filesB = listCorpus(dirB);
+	files.insert(files.end(), filesB.begin(), filesB.end());
+
+	// a few items per thread keep every stage busy
+	size_t capacity = 4 * parseThreads;
+	ConcurrentQueue<ParsedFile> parsed(capacity);
+	ConcurrentQueue<size_t> profiled(capacity);
+	ConcurrentQueue<JoinTask> tasks(capacity);
+	StageCounter parseStage, profileStage, scheduleStage, compareStage;
+	std::vector<CorpusFile> corpus(files.size());
+	std::vector<std::unique_ptr<CorpusIndex::Indexer>> small(files.size());
+	JoinStats stats;
+
+	// a file that didn't parse stops the join; it is reported once all
+	// threads are done
+	size_t failed = files.size();
+	std::unique_ptr<ParsePool> pool(new ParsePool(files.size(), [&](size_t file) {
+		Clock::time_point start = Clock::now();
+		Node<StringNodeData> *tree = parseTree(files[file]);
+		parseStage.addItem(Clock::now() - start);
+		return tree;
+	}, parseThreads, parsed));
+
+	// the label dictionary is only used from this thread, which also indexes
+	// the small files for the comparison threads
+	std::thread profiler([&]() {
+		LabelDictionary<StringNodeData> labels;
+		Clock::time_point start = Clock::now();
+		for (ParsedFile result; parsed.pop(result); start = Clock::now())
+		{
+			if (!result.tree || failed < files.size())
+			{
+				if (!result.tree)
+					failed = std::min(failed, result.file);
+				delete result.tree;
+				continue;
+			}
+			Clock::time_point popped = Clock::now();
+			profileStage.addWaiting(popped - start);
+			corpus[result.file] = {files[result.file], result.tree, TreeProfile<StringNodeData>(result.tree, labels), nullptr, -1};
+			small[result.file].reset(indexSmallCorpusFile(corpus[result.file], labels));
+			profileStage.addItem(Clock::now() - popped);
+			profiled.push(result.file);
+		}
+		profiled.close();
+	});
+
+	std::vector<std::thread> comparers;
+	for (long i = 0; i < parseThreads; i++)
+	{
+		comparers.emplace_back([&]() {
+			RowComparer row(stats);
+			Clock::time_point start = Clock::now();
+			for (JoinTask task; tasks.pop(task); start = Clock::now())
+			{
+				Clock::time_point popped = Clock::now();
+				compareStage.addWaiting(popped - start);
+
+				const CorpusFile &file = corpus[task.file];
+				bool sideB = task.file >= sizeA;
+				auto found = [&](size_t other, float similarity) {
+					if (sideB)
+						printJoinPair(corpus[other], file, similarity, minSimilarity, stats);
+					else
+						printJoinPair(file, corpus[other], similarity, minSimilarity, stats);
+				};
+
+				row.start(file, small[task.file].get());
+				for (size_t other : task.others)
+				{
+					Integer budget = distanceBudget(minSimilarity, file.profile.size, corpus[other].profile.size);
+					if (withinBounds(file, corpus[other], budget, stats))
+						row.compare(corpus[other], small[other].get(), other, found);
+				}
+				row.finish(found);
+				compareStage.addItem(Clock::now() - popped);
+			}
+		});
+	}
+
+	// the files of either side that are ready, by size
+	std::multimap<Integer, size_t> ready[2];
+	Clock::time_point start = Clock::now();
+	for (size_t file; profiled.pop(file); start = Clock::now())
+	{
+		Clock::time_point popped = Clock::now();
+		scheduleStage.addWaiting(popped - start);
+
+		bool sideB = file >= sizeA;
+		Integer size1 = corpus[file].profile.size;
+		JoinTask task = {file, {}};
+		for (auto other = ready[!sideB].lower_bound(lowestJoinSize(size1, minSimilarity)); other != ready[!sideB].end(); other++)
+		{
+			Integer budget;
+			if (!sizesCanMatch(size1, other->first, minSimilarity, budget))
+			{
+				if (other->first > size1)
+					break;
+				continue;
+			}
+			stats.sizePairs++;
+			task.others.push_back(other->second);
+		}
+		if (!task.others.empty())
+			tasks.push(task);
+		ready[sideB].insert({size1, file});
+		scheduleStage.addItem(Clock::now() - popped);
+	}
+	tasks.close();
+
+	for (std::thread &comparer : comparers)
+		comparer.join();
+	profiler.join();
+	pool.reset();
+	if (failed < files.size())
+		failParse(files[failed]);
+
+	if (verbose)
+	{
+		stats.print(sizeA * (files.size() - sizeA));
+		std::cerr << parseStage.report("parse") << "\n"
+				  << profileStage.report("profile") << "\n"
+				  << scheduleStage.report("schedule") << "\n"
+				  << compareStage.report("compare") << "\n";
+	}
+
+	releaseCorpus(corpus);
+}
+
+void joinCorporaByFingerprints(const std::string &dirA, const std::string &dirB, float minSimilarity, double minOverlap)
+{
+	std::vector<std::string> files = listCorpus(dirA);
+	size_t sizeA = files.size();
+	std::vector<std::string> filesB = listCorpus(dirB);
+	files.insert(files.end(), filesB.begin(), filesB.end());
+
+	// every file is lexed with an index of its own, so threads share nothing
+	std::vector<std::vector<uint64_t>> fingerprints(files.size());
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> lexers;
+	for (long i = 0; i < parseThreads; i++)
+	{
+		lexers.emplace_back([&files, &fingerprints, &next]() {
+			for (size_t file; (file = next++) < files.size();)
+				fingerprints[file] = winnowFingerprints(tokenizeFile(files[file]));
+		});
+	}
+	for (std::thread &lexer : lexers)
+		lexer.join();
+
+	std::unordered_map<uint64_t, std::vector<size_t>> filesByFingerprint;
+	for (size_t b = sizeA; b < files.size(); b++)
+	{
+		for (uint64_t fingerprint : fingerprints[b])
+			filesByFingerprint[fingerprint].push_back(b);
+	}
+
+	std::vector<std::pair<size_t, size_t>> candidates;
+	std::vector<bool> needed(files.size(), false);
+	for (size_t a = 0; a < sizeA; a++)
+	{
+		std::unordered_map<size_t, size_t> shared;
+		for (uint64_t fingerprint : fingerprints[a])
+		{
+			auto found = filesByFingerprint.find(fingerprint);
+			if (found == filesByFingerprint.end())
+				continue;
+			for (size_t b : found->second)
+				shared[b]++;
+		}
+
+		for (const std::pair<const size_t, size_t> &count : shared)
+		{
+			size_t fewer = std::min(fingerprints[a].size(), fingerprints[count.first].size());
+			if ((double)count.second / fewer >= minOverlap)
+			{
+				candidates.push_back({a, count.first});
+				needed[a] = needed[count.first] = true;
+			}
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	std::vector<std::string> parsedFiles;
+	std::vector<size_t> positions;
+	for (size_t file = 0; file < files.size(); file++)
+	{
+		if (needed[file])
+		{
+			parsedFiles.push_back(files[file]);
+			positions.push_back(file);
+		}
+	}
+
+	LabelDictionary<StringNodeData> labels;
+	std::vector<CorpusFile> corpus(files.size());
+	std::vector<std::unique_ptr<CorpusIndex::Indexer>> small(files.size());
+	std::vector<Node<StringNodeData> *> trees = parseFiles(parsedFiles);
+	for (size_t i = 0; i < parsedFiles.size(); i++)
+	{
+		corpus[positions[i]] = makeCorpusFile(parsedFiles[i], trees[i], labels);
+		small[positions[i]].reset(indexSmallCorpusFile(corpus[positions[i]], labels));
+	}
+
+	// the candidates of a file of A are a row, threads take a row at a time
+	std::vector<size_t> rows;
+	for (size_t pair = 0; pair < candidates.size(); pair++)
+	{
+		if (pair == 0 || candidates[pair].first != candidates[pair - 1].first)
+			rows.push_back(pair);
+	}
+	rows.push_back(candidates.size());
+
+	JoinStats stats;
+	next = 0;
+	std::vector<std::thread> comparers;
+	for (long i = 0; i < parseThreads; i++)
+	{
+		comparers.emplace_back([&]() {
+			RowComparer row(stats);
+			for (size_t r; (r = next++) + 1 < rows.size();)
+			{
+				const CorpusFile &a = corpus[candidates[rows[r]].first];
+				auto found = [&](size_t b, float similarity) {
+					printJoinPair(a, corpus[b], similarity, minSimilarity, stats);
+				};
+
+				row.start(a, small[candidates[rows[r]].first].get());
+				for (size_t pair = rows[r]; pair < rows[r + 1]; pair++)
+				{
+					size_t b = candidates[pair].second;
+					Integer budget;
+					if (!sizesCanMatch(a.profile.size, corpus[b].profile.size, minSimilarity, budget))
+						continue;
+					stats.sizePairs++;
+
+					if (withinBounds(a, corpus[b], budget, stats))
+						row.compare(corpus[b], small[b].get(), b, found);
+				}
+				row.finish(found);
+			}
+		});
+	}
+	for (std::thread &comparer : comparers)
+		comparer.join();
+
+	if (verbose)
+	{
+		std::cerr << candidates.size() << " candidate pairs by fingerprints, " << parsedFiles.size() << " of "
+				  << files.size() << " files parsed\n";
+		stats.print(sizeA * (files.size() - sizeA));
+	}
+
+	releaseCorpus(corpus);
+}
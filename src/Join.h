@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <iostream>
+
+#include "Codesim.h"
+
+// Joins of two corpora: every pair of a file of A and a file of B with a
+// similarity of at least minSimilarity is printed as
+// "similarity<TAB>fileA<TAB>fileB" as it is found. Also the filters and the
+// row by row comparison the other modes share with them.
+
+// what the filters of a join did
+struct JoinStats
+{
+	std::atomic<size_t> sizePairs, bagPruned, traversalPruned, computed, batched, matches;
+
+	JoinStats() : sizePairs(0), bagPruned(0), traversalPruned(0), computed(0), batched(0), matches(0)
+	{
+	}
+
+	void print(size_t pairs) const
+	{
+		std::cerr << pairs << " pairs: " << sizePairs << " within size range, "
+				  << bagPruned << " pruned by label bags, " << traversalPruned << " by traversals, "
+				  << computed << " distances computed (" << batched << " in batches), " << matches << " similar\n";
+	}
+};
+
+// whether the label bag and traversal bounds leave the distance of the pair
+// within budget. At the function level, they don't hold; only the size range
+// does, see findTopK.
+bool withinBounds(const CorpusFile &a, const CorpusFile &b, capted::Integer budget, JoinStats &stats);
+
+// the similarity of the pair if it is at least minSimilarity, -1 otherwise;
+// its sizes are within budget
+float boundedSimilarity(const CorpusFile &a, const CorpusFile &b, float minSimilarity, capted::Integer budget, JoinStats &stats);
+
+// Compares one file, a row, with the files it is paired with. The file is
+// indexed once for the row, and if it is small, its small partners are
+// compared in batches. Similarities are reported as found(tag, similarity),
+// those of a batch once it is complete; finish() reports the rest of the row.
+// Rows run in threads of their own, so function level comparisons take one
+// thread each.
+struct RowComparer
+{
+	JoinStats &stats;
+	const CorpusFile *a = nullptr;
+	FileIndexers indexersA;
+	SmallPairBatch batch;
+	// the tags and sizes of the files in the batch, by their position in it
+	std::vector<std::pair<size_t, capted::Integer>> batched;
+
+	RowComparer(JoinStats &stats) : stats(stats)
+	{
+	}
+
+	// a row of a, whose small indexer is smallA, if it is small
+	void start(const CorpusFile &a, CorpusIndex::Indexer *smallA)
+	{
+		this->a = &a;
+		indexersA = FileIndexers();
+		batch.query = smallA;
+	}
+
+	template<class Found>
+	void compare(const CorpusFile &b, CorpusIndex::Indexer *smallB, size_t tag, Found found)
+	{
+		stats.computed++;
+		if (batch.query && smallB)
+		{
+			stats.batched++;
+			batched.push_back({tag, b.profile.size});
+			batch.add(smallB, batched.size() - 1, Report<Found>{*this, found});
+			if (batch.candidates.empty())
+				batched.clear();
+		} else
+			found(tag, fileSimilarity(*a, b, &indexersA, 1));
+	}
+
+	template<class Found>
+	void finish(Found found)
+	{
+		batch.compute(Report<Found>{*this, found});
+		batched.clear();
+	}
+
+	// turns the distances of the batch into similarities for found
+	template<class Found>
+	struct Report
+	{
+		RowComparer &row;
+		Found &found;
+
+		void operator()(size_t position, capted::Integer distance) const
+		{
+			const std::pair<size_t, capted::Integer> &file = row.batched[position];
+			found(file.first, unitCostSimilarity(distance, row.a->profile.size, file.second));
+		}
+	};
+};
+
+// the small indexers of a corpus, see indexSmallCorpusFile
+std::vector<std::unique_ptr<CorpusIndex::Indexer>> indexSmallCorpus(const std::vector<CorpusFile> &corpus,
+																	 capted::LabelDictionary<capted::StringNodeData> &labels);
+
+// Prints every pair of files from corpora A and B with a similarity of at
+// least minSimilarity as it is found, without keeping any pairwise results.
+//
+// The similarity turns into a distance budget for each pair. The sizes of two
+// trees differ by no more than their distance, so each file of A is compared
+// only with the files of B in a range of sizes, found in B sorted by size. The
+// label bag and traversal bounds rule out more pairs before the exact
+// distance is computed.
+void joinCorpora(const std::string &dirA, const std::string &dirB, float minSimilarity);
+
+// Joins two directories like joinCorpora, but compares while parsing. Parse
+// threads feed a profiling thread, which feeds a scheduler that pairs each
+// file with the files of the other side that are ready, in the same size
+// range as joinCorpora; comparison threads take it from there, a file and its
+// partners at a time. The queues between the stages are bounded, so that a
+// fast stage blocks rather than piling up work for a slow one.
+void joinCorporaPipelined(const std::string &dirA, const std::string &dirB, float minSimilarity);
+
+// Joins two directories like joinCorpora, but picks the candidate pairs by the
+// overlap of their winnowed token fingerprints first, which takes little more
+// than lexing the files. A pair is a candidate if the files share at least
+// minOverlap of the fingerprints of the one with fewer. Only the files of
+// candidate pairs are parsed, and only candidate pairs are compared; pairs
+// that share no code of some length are missed.
+void joinCorporaByFingerprints(const std::string &dirA, const std::string &dirB, float minSimilarity, double minOverlap);
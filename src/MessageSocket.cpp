@@ -0,0 +1,91 @@
+#include "MessageSocket.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace
+{
+
+bool readAll(int fd, char *data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t count = read(fd, data, size);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+		data += count;
+		size -= count;
+	}
+	return true;
+}
+
+bool writeAll(int fd, const char *data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t count = write(fd, data, size);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+		data += count;
+		size -= count;
+	}
+	return true;
+}
+
+} // namespace
+
+int listenUnixSocket(const std::string &path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+		return -1;
+	strcpy(address.sun_path, path.c_str());
+
+	// a socket left behind by an earlier server, but nothing else
+	struct stat info;
+	if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+		unlink(path.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, 16) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool readMessage(int fd, std::string &message)
+{
+	uint32_t length;
+	if (!readAll(fd, reinterpret_cast<char *>(&length), sizeof(length)))
+		return false;
+	length = ntohl(length);
+	if (length > MAX_MESSAGE_SIZE)
+		return false;
+
+	message.resize(length);
+	return readAll(fd, &message[0], length);
+}
+
+bool writeMessage(int fd, const std::string &message)
+{
+	if (message.size() > MAX_MESSAGE_SIZE)
+		return false;
+	uint32_t length = htonl(message.size());
+	return writeAll(fd, reinterpret_cast<const char *>(&length), sizeof(length))
+		&& writeAll(fd, message.data(), message.size());
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+// Messages over stream sockets: a 4-byte length in network byte order, then
+// that many bytes.
+
+// the largest message either side accepts
+const size_t MAX_MESSAGE_SIZE = 64 << 20;
+
+// a listening Unix domain socket at path, replacing a stale one; -1 on errors
+int listenUnixSocket(const std::string &path);
+
+// false at the end of the stream, on errors and on oversized messages
+bool readMessage(int fd, std::string &message);
+bool writeMessage(int fd, const std::string &message);
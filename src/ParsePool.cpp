@@ -0,0 +1,36 @@
+#include "ParsePool.h"
+
+#include <algorithm>
+
+ParsePool::ParsePool(size_t files, Parse parse, unsigned threads, ConcurrentQueue<ParsedFile> &trees)
+	: files(files)
+	, parse(parse)
+	, trees(trees)
+	, next(0)
+	, running(std::max(threads, 1u))
+{
+	for (unsigned i = 0; i < std::max(threads, 1u); i++)
+		this->threads.emplace_back(&ParsePool::work, this);
+}
+
+ParsePool::~ParsePool()
+{
+	for (std::thread &thread : threads)
+		thread.join();
+}
+
+unsigned ParsePool::defaultThreads()
+{
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void ParsePool::work()
+{
+	// files are handed out one at a time, so that a few large ones don't
+	// leave the other threads idle
+	for (size_t file = next++; file < files; file = next++)
+		trees.push({file, parse(file)});
+
+	if (--running == 0)
+		trees.close();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include "Capted.h"
+#include "ConcurrentQueue.h"
+
+// a tree parsed by a ParsePool, with the position of its file
+struct ParsedFile
+{
+	size_t file;
+	capted::Node<capted::StringNodeData> *tree;
+};
+
+// Threads that parse files 0 to files - 1 and push the trees into a queue, in
+// the order they finish. The queue is closed after the last file. parse is
+// called concurrently, so whatever libclang state it uses has to be per
+// thread. A file that doesn't parse comes out as a null tree, for the thread
+// that takes the trees to report once the pool is gone.
+class ParsePool
+{
+public:
+	typedef std::function<capted::Node<capted::StringNodeData> *(size_t file)> Parse;
+
+	ParsePool(size_t files, Parse parse, unsigned threads, ConcurrentQueue<ParsedFile> &trees);
+
+	// waits for the threads, so the queue has to be drained before
+	~ParsePool();
+
+	ParsePool(const ParsePool &) = delete;
+	ParsePool &operator=(const ParsePool &) = delete;
+
+	// one thread per core, at least one
+	static unsigned defaultThreads();
+
+private:
+	size_t files;
+	Parse parse;
+	ConcurrentQueue<ParsedFile> &trees;
+	std::atomic<size_t> next;
+	std::atomic<unsigned> running;
+	std::vector<std::thread> threads;
+
+	void work();
+};
@@ -0,0 +1,111 @@
+#include "PreambleCache.h"
+#include "AstCache.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// The leading blank lines, comments and preprocessor directives of a file,
+// which is where clang looks for the preamble, and what else decides how they
+// are parsed: the language, by the extension, and for quoted includes the
+// directory they are found from.
+std::string prologueKey(const std::string &filename, const std::string &contents)
+{
+	size_t end = 0;
+	size_t position = 0;
+	bool inComment = false;
+	bool continued = false;
+	while (position < contents.size())
+	{
+		size_t lineEnd = contents.find('\n', position);
+		if (lineEnd == std::string::npos)
+			lineEnd = contents.size();
+		std::string line = contents.substr(position, lineEnd - position);
+		size_t first = line.find_first_not_of(" \t\r");
+		size_t last = line.find_last_not_of(" \t\r");
+
+		if (inComment)
+			inComment = line.find("*/") == std::string::npos;
+		else if (continued || first == std::string::npos || line.compare(first, 2, "//") == 0)
+			;
+		else if (line.compare(first, 2, "/*") == 0)
+			inComment = line.find("*/", first + 2) == std::string::npos;
+		else if (line[first] != '#')
+			break;
+
+		// directives and line comments go on after a backslash
+		continued = !inComment && last != std::string::npos && line[last] == '\\';
+		position = lineEnd + 1;
+		end = std::min(position, contents.size());
+	}
+
+	std::string prologue = contents.substr(0, end);
+	return parseContext(filename, prologue) + '\0' + prologue;
+}
+
+} // namespace
+
+PreambleCache::PreambleCache(const char *const *arguments, int argumentCount, bool displayDiagnostics,
+							 unsigned globalOptions, size_t capacity)
+	: index(clang_createIndex(0, displayDiagnostics))
+	, arguments(arguments)
+	, argumentCount(argumentCount)
+	, capacity(capacity)
+	, clock(0)
+{
+	clang_CXIndex_setGlobalOptions(index, globalOptions);
+}
+
+PreambleCache::~PreambleCache()
+{
+	for (auto &entry : units)
+		clang_disposeTranslationUnit(entry.second.translationUnit);
+	clang_disposeIndex(index);
+}
+
+CXTranslationUnit PreambleCache::parse(const std::string &filename, const std::string &contents)
+{
+	std::string key = prologueKey(filename, contents);
+	clock++;
+
+	auto found = units.find(key);
+	if (found != units.end())
+	{
+		Unit &unit = found->second;
+		CXUnsavedFile file = {unit.filename.c_str(), contents.data(), contents.size()};
+		if (clang_reparseTranslationUnit(unit.translationUnit, 1, &file, clang_defaultReparseOptions(unit.translationUnit)) == 0)
+		{
+			unit.lastUse = clock;
+			return unit.translationUnit;
+		}
+
+		// a translation unit that fails to reparse can only be disposed
+		clang_disposeTranslationUnit(unit.translationUnit);
+		units.erase(found);
+	}
+
+	if (units.size() >= capacity)
+		evictLeastRecentlyUsed();
+
+	CXUnsavedFile file = {filename.c_str(), contents.data(), contents.size()};
+	CXTranslationUnit translationUnit = nullptr;
+	unsigned options = CXTranslationUnit_PrecompiledPreamble | CXTranslationUnit_CreatePreambleOnFirstParse;
+	if (clang_parseTranslationUnit2(index, filename.c_str(), arguments, argumentCount, &file, 1, options, &translationUnit) != CXError_Success)
+		return nullptr;
+
+	units[key] = {filename, translationUnit, clock};
+	return translationUnit;
+}
+
+void PreambleCache::evictLeastRecentlyUsed()
+{
+	auto oldest = units.begin();
+	for (auto entry = units.begin(); entry != units.end(); entry++)
+	{
+		if (entry->second.lastUse < oldest->second.lastUse)
+			oldest = entry;
+	}
+	clang_disposeTranslationUnit(oldest->second.translationUnit);
+	units.erase(oldest);
+}
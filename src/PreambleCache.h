@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+#include <clang-c/Index.h>
+
+// Translation units kept alive per include prologue, so that files starting
+// with the same includes share one precompiled preamble. The first file with a
+// prologue is parsed with a preamble; later ones are reparsed in its place, as
+// unsaved contents of the same main file, and clang reuses the preamble as
+// long as the prologue is byte for byte the same.
+class PreambleCache
+{
+public:
+	// globalOptions are the CXGlobalOptFlags of the libclang index
+	PreambleCache(const char *const *arguments, int argumentCount, bool displayDiagnostics,
+				  unsigned globalOptions = CXGlobalOpt_None, size_t capacity = 16);
+	~PreambleCache();
+
+	PreambleCache(const PreambleCache &) = delete;
+	PreambleCache &operator=(const PreambleCache &) = delete;
+
+	// parses contents as the file filename. The translation unit belongs to
+	// the cache and stays valid until the next call; nullptr if parsing fails.
+	CXTranslationUnit parse(const std::string &filename, const std::string &contents);
+
+private:
+	struct Unit
+	{
+		std::string filename;
+		CXTranslationUnit translationUnit;
+		uint64_t lastUse;
+	};
+
+	CXIndex index;
+	const char *const *arguments;
+	int argumentCount;
+	size_t capacity;
+	std::unordered_map<std::string, Unit> units;
+	uint64_t clock;
+
+	void evictLeastRecentlyUsed();
+};
@@ -0,0 +1,263 @@
+#include "ResultWriter.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace
+{
+
+const size_t BUFFER_SIZE = 1 << 20;
+
+// Text formats collect lines in a large buffer of their own, which is written
+// when it fills up; stdout may have been used before, so its FILE buffer can't
+// be replaced.
+class TextWriter : public ResultWriter
+{
+public:
+	TextWriter(FILE *file, const std::vector<std::string> &files)
+		: file(file)
+		, files(files)
+	{
+		pending.reserve(BUFFER_SIZE);
+	}
+
+	bool close() override
+	{
+		bool ok = flush();
+		ok = (file == stdout ? fflush(file) : fclose(file)) == 0 && ok;
+		file = nullptr;
+		return ok;
+	}
+
+	~TextWriter()
+	{
+		if (file)
+			close();
+	}
+
+protected:
+	FILE *file;
+	const std::vector<std::string> &files;
+
+	void append(const std::string &line)
+	{
+		pending += line;
+		if (pending.size() >= BUFFER_SIZE)
+			flush();
+	}
+
+	static std::string formatSimilarity(float similarity)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "%g", similarity);
+		return text;
+	}
+
+private:
+	std::string pending;
+	bool failed = false;
+
+	bool flush()
+	{
+		if (!pending.empty() && fwrite(pending.data(), 1, pending.size(), file) != pending.size())
+			failed = true;
+		pending.clear();
+		return !failed;
+	}
+};
+
+class CsvWriter : public TextWriter
+{
+public:
+	CsvWriter(FILE *file, const std::vector<std::string> &files) : TextWriter(file, files)
+	{
+		append("file1,file2,similarity\n");
+	}
+
+	void write(size_t i, size_t j, float similarity) override
+	{
+		append(quote(files[i]) + "," + quote(files[j]) + "," + formatSimilarity(similarity) + "\n");
+	}
+
+private:
+	static std::string quote(const std::string &field)
+	{
+		std::string quoted = "\"";
+		for (char c : field)
+			quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+		return quoted + "\"";
+	}
+};
+
+class JsonLinesWriter : public TextWriter
+{
+public:
+	using TextWriter::TextWriter;
+
+	void write(size_t i, size_t j, float similarity) override
+	{
+		append("{\"file1\": " + quote(files[i]) + ", \"file2\": " + quote(files[j]) + ", \"similarity\": " + formatSimilarity(similarity) + "}\n");
+	}
+
+private:
+	static std::string quote(const std::string &value)
+	{
+		std::string quoted = "\"";
+		for (unsigned char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				quoted += '\\';
+				quoted += c;
+			} else if (c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				quoted += escaped;
+			} else
+				quoted += c;
+		}
+		return quoted + "\"";
+	}
+};
+
+class SparseWriter : public TextWriter
+{
+public:
+	using TextWriter::TextWriter;
+
+	void write(size_t i, size_t j, float similarity) override
+	{
+		append(formatSimilarity(similarity) + "\t" + escape(files[i]) + "\t" + escape(files[j]) + "\n");
+	}
+
+private:
+	// a path may hold the separators, so tabs and line breaks are written as
+	// \t, \n and \r, which makes backslashes \\ too
+	static std::string escape(const std::string &path)
+	{
+		std::string escaped;
+		for (char c : path)
+		{
+			if (c == '\\')
+				escaped += "\\\\";
+			else if (c == '\t')
+				escaped += "\\t";
+			else if (c == '\n')
+				escaped += "\\n";
+			else if (c == '\r')
+				escaped += "\\r";
+			else
+				escaped += c;
+		}
+		return escaped;
+	}
+};
+
+struct MatrixHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t fileCount;
+	uint64_t matrixOffset;
+	uint64_t pathsOffset;
+};
+
+// The binary file is laid out and sized up front and mapped, so that a pair
+// is a store into the mapping, in any order.
+class BinaryWriter : public ResultWriter
+{
+public:
+	BinaryWriter(int descriptor, const std::vector<std::string> &files)
+		: descriptor(descriptor)
+		, fileCount(files.size())
+		, mapping(nullptr)
+		, matrix(nullptr)
+	{
+		uint64_t pairs = fileCount * (fileCount - (fileCount > 0)) / 2;
+		MatrixHeader header = {{'C', 'S', 'S', 'M'}, 1, fileCount, 64, 0};
+		header.pathsOffset = header.matrixOffset + pairs * sizeof(float);
+
+		size = header.pathsOffset;
+		for (const std::string &path : files)
+			size += sizeof(uint32_t) + path.size();
+
+		if (ftruncate(descriptor, size) != 0)
+			return;
+		void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+		if (memory == MAP_FAILED)
+			return;
+		mapping = static_cast<char *>(memory);
+		matrix = reinterpret_cast<float *>(mapping + header.matrixOffset);
+
+		std::memcpy(mapping, &header, sizeof(header));
+		char *position = mapping + header.pathsOffset;
+		for (const std::string &path : files)
+		{
+			uint32_t length = path.size();
+			std::memcpy(position, &length, sizeof(length));
+			std::memcpy(position + sizeof(length), path.data(), length);
+			position += sizeof(length) + length;
+		}
+	}
+
+	~BinaryWriter()
+	{
+		if (descriptor >= 0)
+			close();
+	}
+
+	void write(size_t i, size_t j, float similarity) override
+	{
+		if (matrix)
+			matrix[i * (2 * fileCount - i - 1) / 2 + j - i - 1] = similarity;
+	}
+
+	bool close() override
+	{
+		bool ok = mapping != nullptr;
+		if (mapping)
+			ok = munmap(mapping, size) == 0;
+		ok = ::close(descriptor) == 0 && ok;
+		descriptor = -1;
+		mapping = nullptr;
+		matrix = nullptr;
+		return ok;
+	}
+
+private:
+	int descriptor;
+	uint64_t fileCount;
+	uint64_t size;
+	char *mapping;
+	float *matrix;
+};
+
+} // namespace
+
+ResultWriter *ResultWriter::create(const std::string &format, const std::string &path, const std::vector<std::string> &files)
+{
+	if (format == "binary")
+	{
+		if (path == "-")
+			return nullptr;
+		int descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		return descriptor < 0 ? nullptr : new BinaryWriter(descriptor, files);
+	}
+
+	if (format != "csv" && format != "jsonl" && format != "sparse")
+		return nullptr;
+
+	FILE *file = path == "-" ? stdout : fopen(path.c_str(), "w");
+	if (!file)
+		return nullptr;
+	if (format == "csv")
+		return new CsvWriter(file, files);
+	if (format == "jsonl")
+		return new JsonLinesWriter(file, files);
+	return new SparseWriter(file, files);
+}
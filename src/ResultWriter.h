@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Writes the similarities of pairs of files of a corpus, each pair (i, j) with
+// i < j once, in whatever order the pairs are computed. Output is buffered and
+// written in large blocks, never per pair. Formats:
+//
+//   csv     "file1,file2,similarity" header, then one quoted line per pair
+//   jsonl   {"file1": ..., "file2": ..., "similarity": ...} per pair
+//   sparse  similarity<TAB>file1<TAB>file2 per pair, for pairs that were
+//           written at all, e.g. only those above a threshold. Paths are
+//           escaped: \t, \n and \r for tabs and line breaks, \\ for a
+//           backslash
+//   binary  the upper triangle of the similarity matrix as 32-bit floats,
+//           memory-mappable (see below); pairs not written are 0
+//
+// A binary file is, in native byte order:
+//
+//   header  char magic[4] = "CSSM", uint32 version = 1, uint64 files,
+//           uint64 matrix offset, uint64 paths offset
+//   matrix  at a 64-byte aligned offset, the similarity of (i, j) for i < j
+//           at position i * (2 * files - i - 1) / 2 + j - i - 1, row by row
+//   paths   per file a uint32 length and that many bytes
+class ResultWriter
+{
+public:
+	virtual ~ResultWriter() {}
+
+	// one call at a time
+	virtual void write(size_t i, size_t j, float similarity) = 0;
+
+	// flushes and closes the output; false if anything failed to be written
+	virtual bool close() = 0;
+
+	// a writer of format to path, "-" for stdout, which binary can't be
+	// written to; nullptr for an unknown format or if path can't be opened
+	static ResultWriter *create(const std::string &format, const std::string &path, const std::vector<std::string> &files);
+};
@@ -0,0 +1,120 @@
+#include "Revisions.h"
+
+#include <iostream>
+#include <map>
+
+#include "Codesim.h"
+#include "AstCache.h"
+#include "ConcurrentQueue.h"
+#include "ParsePool.h"
+#include "GitRepository.h"
+
+using namespace capted;
+
+void compareRevisions(const std::string &repository, const std::string &revision1, const std::string &revision2)
+{
+	GitRepository git(repository);
+	std::vector<GitRepository::File> files1, files2;
+	for (const GitRepository::File &file : git.listFiles(revision1))
+	{
+		if (isSourceFile(file.path))
+			files1.push_back(file);
+	}
+	for (const GitRepository::File &file : git.listFiles(revision2))
+	{
+		if (isSourceFile(file.path))
+			files2.push_back(file);
+	}
+
+	// the tree of every blob in the parse context of its path, by the key of
+	// both, and what is left to parse. Blobs are parsed under their path in
+	// the repository, so that quoted includes are found in its working tree,
+	// if there is one.
+	std::map<std::string, Node<StringNodeData> *> trees;
+	std::vector<std::string> keys1, keys2;
+	std::vector<std::string> keys, paths, contents;
+	std::map<std::string, std::string> read;
+	for (auto side : {std::make_pair(&files1, &keys1), std::make_pair(&files2, &keys2)})
+	{
+		for (const GitRepository::File &file : *side.first)
+		{
+			auto blob = read.find(file.blob);
+			if (blob == read.end())
+				blob = read.emplace(file.blob, git.readBlob(file.blob)).first;
+			std::string path = repository + "/" + file.path;
+			std::string key = "git blob " + file.blob + '\0' + parseContext(path, blob->second);
+			side.second->push_back(key);
+			if (trees.count(key))
+				continue;
+
+			Node<StringNodeData> *cached = astCache ? astCache->load(key) : nullptr;
+			trees[key] = cached;
+			if (!cached)
+			{
+				keys.push_back(key);
+				paths.push_back(path);
+				contents.push_back(blob->second);
+			}
+		}
+	}
+	read.clear();
+
+	ConcurrentQueue<ParsedFile> parsed;
+	{
+		ParsePool pool(keys.size(), [&](size_t i) { return parseContents(paths[i], contents[i], keys[i]); }, parseThreads, parsed);
+
+		for (ParsedFile result; parsed.pop(result);)
+			trees[keys[result.file]] = result.tree;
+	}
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		if (!trees[keys[i]])
+			failParse(paths[i]);
+	}
+
+	// both lists are sorted by path
+	Integer distanceSum = 0, sizeSum = 0;
+	size_t unchanged = 0;
+	size_t i1 = 0, i2 = 0;
+	while (i1 < files1.size() || i2 < files2.size())
+	{
+		if (i2 == files2.size() || (i1 < files1.size() && files1[i1].path < files2[i2].path))
+		{
+			Integer size = trees[keys1[i1]]->getNodeCount();
+			distanceSum += size;
+			sizeSum += size;
+			std::cout << "removed\t" << files1[i1].path << "\n";
+			i1++;
+		} else if (i1 == files1.size() || files2[i2].path < files1[i1].path)
+		{
+			Integer size = trees[keys2[i2]]->getNodeCount();
+			distanceSum += size;
+			sizeSum += size;
+			std::cout << "added\t" << files2[i2].path << "\n";
+			i2++;
+		} else
+		{
+			Node<StringNodeData> *t1 = trees[keys1[i1]];
+			Node<StringNodeData> *t2 = trees[keys2[i2]];
+			Integer size1 = t1->getNodeCount(), size2 = t2->getNodeCount();
+			sizeSum += size1 + size2;
+			if (files1[i1].blob == files2[i2].blob)
+				unchanged++;
+			else
+			{
+				Integer distance = computeEditDistance(t1, t2);
+				distanceSum += distance;
+				std::cout << unitCostSimilarity(distance, size1, size2) << "\t" << files1[i1].path << "\n";
+			}
+			i1++;
+			i2++;
+		}
+	}
+
+	if (verbose)
+		std::cerr << trees.size() << " trees, " << keys.size() << " parsed, " << unchanged << " files unchanged\n";
+	std::cout << (sizeSum ? 1 - (float)distanceSum / sizeSum : 1) << "\t" << revision1 << "\t" << revision2 << std::endl;
+
+	for (std::pair<const std::string, Node<StringNodeData> *> &tree : trees)
+		delete tree.second;
+}
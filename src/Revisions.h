@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+// Compares two revisions of a git repository file by file. Files are known
+// by their blob ids and parse contexts, so a blob in both revisions is parsed
+// at most once per context, and not at all if the AST cache has it; only
+// files whose blobs differ are compared. Prints a "similarity<TAB>path" line
+// per changed file, an "added<TAB>path" or "removed<TAB>path" line per file in
+// one revision only, and then the similarity of the revisions over all of
+// their files.
+void compareRevisions(const std::string &repository, const std::string &revision1, const std::string &revision2);
@@ -0,0 +1,142 @@
+#include "Server.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Codesim.h"
+#include "MessageSocket.h"
+
+using namespace capted;
+
+namespace
+{
+
+// parses a file named in a request; nullptr with error set if that fails
+Node<StringNodeData> *parseRequestFile(const std::string &path, std::string &error)
+{
+	if (!std::ifstream(path).good())
+	{
+		error = "Can't open the file: " + path;
+		return nullptr;
+	}
+	Node<StringNodeData> *tree = parseTree(path);
+	if (!tree)
+		error = "Unable to parse translation unit " + path;
+	return tree;
+}
+
+// Answers one request of the --serve protocol. Requests and responses are
+// lines; a response starts with "ok" or "error".
+//
+//   compare, file1, file2 -> ok, similarity
+//   query, k, file        -> ok, one similarity<TAB>path line per match
+//   add, file             -> ok, number of files in the corpus
+//   remove, file          -> ok, number of files in the corpus
+std::string answerRequest(const std::string &request, LabelDictionary<StringNodeData> &labels, std::vector<CorpusFile> &corpus)
+{
+	// a final newline is optional
+	size_t length = request.size();
+	if (length > 0 && request[length - 1] == '\n')
+		length--;
+
+	std::vector<std::string> fields;
+	for (size_t start = 0, end; start <= length; start = end + 1)
+	{
+		end = std::min(request.find('\n', start), length);
+		fields.push_back(request.substr(start, end - start));
+	}
+
+	const std::string &command = fields[0];
+	std::string error;
+	std::ostringstream response;
+	response << "ok\n";
+
+	if (command == "compare" && fields.size() == 3)
+	{
+		Node<StringNodeData> *t1 = parseRequestFile(fields[1], error);
+		Node<StringNodeData> *t2 = t1 ? parseRequestFile(fields[2], error) : nullptr;
+		if (t2)
+			response << unitCostSimilarity(computeEditDistance(t1, t2), t1->getNodeCount(), t2->getNodeCount()) << "\n";
+		delete t1;
+		delete t2;
+	} else if (command == "query" && fields.size() == 3)
+	{
+		long k = strtol(fields[1].c_str(), nullptr, 10);
+		if (k < 1)
+			error = "Invalid k: " + fields[1];
+		else if (Node<StringNodeData> *tree = parseRequestFile(fields[2], error))
+		{
+			std::vector<CorpusFile> queryCorpus = {makeCorpusFile(fields[2], tree, labels)};
+			for (const std::pair<float, size_t> &result : findTopK(queryCorpus.front(), corpus, k, labels))
+				response << result.first << "\t" << corpus[result.second].path << "\n";
+			releaseCorpus(queryCorpus);
+		}
+	} else if ((command == "add" || command == "remove") && fields.size() == 2)
+	{
+		// a file added again replaces its earlier version
+		auto known = std::find_if(corpus.begin(), corpus.end(), [&fields](const CorpusFile &file) {
+			return file.path == fields[1];
+		});
+		Node<StringNodeData> *tree = command == "add" ? parseRequestFile(fields[1], error) : nullptr;
+		if (command == "remove" && known == corpus.end())
+			error = "Not in the corpus: " + fields[1];
+
+		if (error.empty() && known != corpus.end())
+		{
+			releaseCorpusFile(*known);
+			corpus.erase(known);
+		}
+		if (tree)
+			corpus.push_back(storeCorpusFile(fields[1], tree, labels));
+		if (error.empty())
+			response << corpus.size() << "\n";
+	} else
+	{
+		error = "Invalid request: " + command;
+	}
+
+	return error.empty() ? response.str() : "error\n" + error + "\n";
+}
+
+} // namespace
+
+void serve(const std::string &socketPath, const std::string &corpusPath)
+{
+	LabelDictionary<StringNodeData> labels;
+	std::vector<CorpusFile> corpus;
+	if (!corpusPath.empty())
+		corpus = loadCorpus(corpusPath, labels);
+
+	// a client that hangs up early must not end the server
+	signal(SIGPIPE, SIG_IGN);
+
+	int listener = listenUnixSocket(socketPath);
+	if (listener < 0)
+	{
+		std::cerr << "Can't listen on the socket: " << socketPath << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (verbose)
+		std::cerr << "Serving " << corpus.size() << " files on " << socketPath << "\n";
+
+	for (;;)
+	{
+		int connection = accept(listener, nullptr, nullptr);
+		if (connection < 0)
+			continue;
+
+		for (std::string request; readMessage(connection, request);)
+		{
+			if (!writeMessage(connection, answerRequest(request, labels, corpus)))
+				break;
+		}
+		close(connection);
+	}
+}
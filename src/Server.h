@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Answers requests on a Unix domain socket until killed, one connection at a
+// time, any number of requests per connection. The corpus, the label
+// dictionary and the parser's preambles stay loaded between requests, so a
+// request costs only its own parsing and comparisons.
+void serve(const std::string &socketPath, const std::string &corpusPath);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+// What a stage of a pipeline did, summed over its threads: the items it
+// handled, the time it spent on them, and the time it waited for input. The
+// stage that waits least while the stages after it wait most is the
+// bottleneck.
+class StageCounter
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	StageCounter() : items(0), busy(0), waiting(0)
+	{
+	}
+
+	void addItem(Clock::duration time)
+	{
+		items++;
+		busy += std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+	}
+
+	void addWaiting(Clock::duration time)
+	{
+		waiting += std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+	}
+
+	// "name: items in busy s (rate/s), waiting s"
+	std::string report(const std::string &name) const
+	{
+		double busySeconds = busy / 1e6;
+		std::ostringstream out;
+		out << name << ": " << items << " in " << busySeconds << "s";
+		if (busySeconds > 0)
+			out << " (" << items / busySeconds << "/s)";
+		out << ", waiting " << waiting / 1e6 << "s";
+		return out.str();
+	}
+
+private:
+	std::atomic<size_t> items;
+	std::atomic<long long> busy;
+	std::atomic<long long> waiting;
+};
@@ -0,0 +1,114 @@
+#include "Watch.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+
+#include "Codesim.h"
+#include "AstCache.h"
+#include "DirectoryWatcher.h"
+#include "Join.h"
+
+using namespace capted;
+
+namespace
+{
+
+// The files of a corpus that changes file by file, kept with what comparing
+// them needs. A change recomputes only the row of the changed file; the
+// pairs of the other files stand.
+struct IncrementalCorpus
+{
+	float minSimilarity;
+	LabelDictionary<StringNodeData> labels;
+	std::map<std::string, CorpusFile> files;
+	// hashes of the contents the files were parsed from
+	std::map<std::string, uint64_t> hashes;
+};
+
+// Drops a file, or all files below a directory, and prints a "removed<TAB>path"
+// line for each: their pairs are void.
+void removeCorpusFile(IncrementalCorpus &corpus, const std::string &path, bool directory = false)
+{
+	std::string prefix = directory ? path + "/" : path;
+	for (auto file = corpus.files.lower_bound(prefix); file != corpus.files.end();)
+	{
+		if (directory ? file->first.compare(0, prefix.size(), prefix) != 0 : file->first != path)
+			break;
+
+		std::cout << "removed\t" << file->first << "\n";
+		releaseCorpusFile(file->second);
+		corpus.hashes.erase(file->first);
+		file = corpus.files.erase(file);
+	}
+}
+
+// Adds a parsed file, or replaces the earlier version of it, and prints its row:
+// a "similarity<TAB>path<TAB>other" line for every other file it is similar to.
+void updateCorpusFile(IncrementalCorpus &corpus, const std::string &path, Node<StringNodeData> *tree, uint64_t hash)
+{
+	removeCorpusFile(corpus, path);
+
+	CorpusFile file = makeCorpusFile(path, tree, corpus.labels);
+	JoinStats stats;
+	for (const std::pair<const std::string, CorpusFile> &other : corpus.files)
+	{
+		Integer budget;
+		if (!sizesCanMatch(file.profile.size, other.second.profile.size, corpus.minSimilarity, budget))
+			continue;
+
+		float similarity = boundedSimilarity(file, other.second, corpus.minSimilarity, budget, stats);
+		if (similarity >= 0)
+			std::cout << similarity << "\t" << path << "\t" << other.first << "\n";
+	}
+
+	corpus.files.insert({path, file});
+	corpus.hashes[path] = hash;
+}
+
+} // namespace
+
+void watchCorpus(const std::string &dir, float minSimilarity)
+{
+	IncrementalCorpus corpus;
+	corpus.minSimilarity = minSimilarity;
+
+	// watch before listing, so that no change falls in between
+	DirectoryWatcher watcher(dir);
+	std::vector<std::string> files = listCorpus(dir);
+	std::vector<Node<StringNodeData> *> trees = parseFiles(files);
+	for (size_t i = 0; i < files.size(); i++)
+		updateCorpusFile(corpus, files[i], trees[i], fnv1a(readFile(files[i])));
+	std::cout.flush();
+
+	for (std::vector<DirectoryWatcher::Change> changes; watcher.wait(changes); changes.clear())
+	{
+		for (const DirectoryWatcher::Change &change : changes)
+		{
+			if (change.kind == DirectoryWatcher::Change::REMOVED)
+			{
+				removeCorpusFile(corpus, change.path, change.directory);
+				continue;
+			}
+			if (!isSourceFile(change.path))
+				continue;
+
+			uint64_t hash = fnv1a(readFile(change.path));
+			auto known = corpus.hashes.find(change.path);
+			if (known != corpus.hashes.end() && known->second == hash)
+				continue;
+
+			if (Node<StringNodeData> *tree = parseTree(change.path))
+				updateCorpusFile(corpus, change.path, tree, hash);
+			else
+			{
+				std::cerr << "Unable to parse translation unit " << change.path << std::endl;
+				removeCorpusFile(corpus, change.path);
+			}
+		}
+		std::cout.flush();
+	}
+
+	std::cerr << "Can't watch the directory any longer: " << dir << std::endl;
+	exit(EXIT_FAILURE);
+}
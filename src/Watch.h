@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Prints the similar pairs among the files below dir, then keeps them up to
+// date as files are written, moved and removed, until killed. Each change is
+// printed as a "removed" line for the changed file, if it was known, followed
+// by its new row. Files written with the contents they had are left alone.
+void watchCorpus(const std::string &dir, float minSimilarity);
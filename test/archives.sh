@@ -0,0 +1,60 @@
+#!/bin/sh
+# Runs every entry point that takes a corpus on corpus.tar and corpus.zip.
+# usage: archives.sh path/to/codesim path/to/test
+
+codesim=$1
+dir=$2
+work=$(mktemp -d)
+trap 'kill $server 2>/dev/null; rm -rf "$work"' EXIT
+failed=0
+
+check()
+{
+	if [ "$2" = 0 ]; then
+		echo "$1 ✓"
+	else
+		echo "$1 FAIL"
+		failed=1
+	fi
+}
+
+# the number of lines of file that name a member of the archive
+members()
+{
+	grep -c "$2/sample" "$1"
+}
+
+for archive in "$dir/corpus.tar" "$dir/corpus.zip"; do
+	name=$(basename "$archive")
+
+	"$codesim" --query "$dir/sample1.c" --corpus "$archive" --top 3 > "$work/query" 2>&1
+	[ $? = 0 ] && [ "$(members "$work/query" "$archive")" = 3 ]
+	check "query $name" $?
+
+	"$codesim" --join "$archive" "$archive" --min-similarity 0 > "$work/join" 2>&1
+	[ $? = 0 ] && [ "$(members "$work/join" "$archive")" = 9 ]
+	check "join $name" $?
+
+	# pairs without a shared fingerprint are not candidates, but copies are
+	"$codesim" --join "$archive" "$archive" --min-similarity 0 --prefilter 0 > "$work/prefilter" 2>&1
+	[ $? = 0 ] && [ "$(members "$work/prefilter" "$archive")" -ge 3 ]
+	check "join --prefilter $name" $?
+
+	"$codesim" --write-index "$work/$name.idx" --corpus "$archive" > "$work/write" 2>&1
+	[ $? = 0 ] && "$codesim" --query "$dir/sample1.c" --corpus "$work/$name.idx" --top 3 > "$work/indexed" 2>&1 \
+		&& cmp -s "$work/query" "$work/indexed"
+	check "write-index $name" $?
+
+	"$codesim" --verbose --serve "$work/socket" --corpus "$archive" 2> "$work/serve" &
+	server=$!
+	for _ in 1 2 3 4 5 6 7 8 9 10; do
+		grep -q "Serving" "$work/serve" && break
+		sleep 1
+	done
+	grep -q "Serving 3 files" "$work/serve"
+	check "serve $name" $?
+	kill $server 2>/dev/null
+	wait $server 2>/dev/null
+done
+
+exit $failed
@@ -0,0 +1,489 @@
+// Tests of the modules of codesim that don't need libclang. Prints a line per
+// test, "name ✓" or "name FAIL", and exits with 1 if any failed.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "includes/json.hpp"
+#include "Capted.h"
+#include "Archive.h"
+#include "CorpusIndex.h"
+#include "ResultWriter.h"
+
+using namespace capted;
+
+namespace
+{
+
+int failures = 0;
+
+// the directory the tests write their files to, removed at exit
+std::string scratchDir;
+std::vector<std::string> scratchFiles;
+
+void check(const std::string &name, bool passed)
+{
+	std::cout << name << (passed ? " ✓" : " FAIL") << std::endl;
+	if (!passed)
+		failures++;
+}
+
+std::string scratchPath(const std::string &name)
+{
+	std::string path = scratchDir + "/" + name;
+	scratchFiles.push_back(path);
+	return path;
+}
+
+std::string readFile(const std::string &path)
+{
+	std::ifstream in(path, std::ios::binary);
+	std::stringstream contents;
+	contents << in.rdbuf();
+	return contents.str();
+}
+
+// whether run exits the process with EXIT_FAILURE, as modules do on errors;
+// it runs in a child process, with stderr discarded
+template<class Run>
+bool exitsWithFailure(Run run)
+{
+	pid_t child = fork();
+	if (child == 0)
+	{
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDERR_FILENO);
+		run();
+		_exit(EXIT_SUCCESS);
+	}
+	int status;
+	return child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE;
+}
+
+// the lines of text, sorted, as writers write pairs in any order
+std::vector<std::string> sortedLines(const std::string &text)
+{
+	std::vector<std::string> lines;
+	std::istringstream in(text);
+	for (std::string line; std::getline(in, line);)
+		lines.push_back(line);
+	std::sort(lines.begin(), lines.end());
+	return lines;
+}
+
+//------------------------------------------------------------------------------
+// ResultWriter
+//------------------------------------------------------------------------------
+
+// Four files, two with separators in their paths, and every pair but (1, 2)
+// written out of order. The similarity of (i, j) is (4 * i + j) / 16, which
+// prints exactly.
+const std::vector<std::string> resultFiles = {"a.c", "b\tc.c", "d\ne.c", "f\\g.c"};
+const std::pair<size_t, size_t> resultPairs[] = {{2, 3}, {0, 2}, {1, 3}, {0, 1}, {0, 3}};
+
+float pairSimilarity(size_t i, size_t j)
+{
+	return (4 * i + j) / 16.0f;
+}
+
+std::string writeResults(const std::string &format)
+{
+	std::string path = scratchPath("results." + format);
+	ResultWriter *writer = ResultWriter::create(format, path, resultFiles);
+	if (!writer)
+		return "";
+	for (const std::pair<size_t, size_t> &pair : resultPairs)
+		writer->write(pair.first, pair.second, pairSimilarity(pair.first, pair.second));
+	bool closed = writer->close();
+	delete writer;
+	return closed ? readFile(path) : "";
+}
+
+void testCsvResults()
+{
+	std::vector<std::string> expected = {
+		"\"a.c\",\"b\tc.c\",0.0625", "\"a.c\",\"d", "\"a.c\",\"f\\g.c\",0.1875", "\"b\tc.c\",\"f\\g.c\",0.4375",
+		"e.c\",0.125", "e.c\",\"f\\g.c\",0.6875", "\"d", "file1,file2,similarity",
+	};
+	std::sort(expected.begin(), expected.end());
+	std::string text = writeResults("csv");
+	check("csv results", text.compare(0, 23, "file1,file2,similarity\n") == 0 && sortedLines(text) == expected);
+}
+
+void testJsonLinesResults()
+{
+	std::vector<std::string> expected = {
+		"{\"file1\": \"a.c\", \"file2\": \"b\\u0009c.c\", \"similarity\": 0.0625}",
+		"{\"file1\": \"a.c\", \"file2\": \"d\\u000ae.c\", \"similarity\": 0.125}",
+		"{\"file1\": \"a.c\", \"file2\": \"f\\\\g.c\", \"similarity\": 0.1875}",
+		"{\"file1\": \"b\\u0009c.c\", \"file2\": \"f\\\\g.c\", \"similarity\": 0.4375}",
+		"{\"file1\": \"d\\u000ae.c\", \"file2\": \"f\\\\g.c\", \"similarity\": 0.6875}",
+	};
+	std::sort(expected.begin(), expected.end());
+	check("jsonl results", sortedLines(writeResults("jsonl")) == expected);
+}
+
+void testSparseResults()
+{
+	std::vector<std::string> expected = {
+		"0.0625\ta.c\tb\\tc.c", "0.125\ta.c\td\\ne.c", "0.1875\ta.c\tf\\\\g.c",
+		"0.4375\tb\\tc.c\tf\\\\g.c", "0.6875\td\\ne.c\tf\\\\g.c",
+	};
+	std::sort(expected.begin(), expected.end());
+	std::vector<std::string> lines = sortedLines(writeResults("sparse"));
+	bool fields = true;
+	for (const std::string &line : lines)
+		fields = fields && std::count(line.begin(), line.end(), '\t') == 2;
+	check("sparse results", lines == expected && fields);
+}
+
+struct MatrixHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t fileCount;
+	uint64_t matrixOffset;
+	uint64_t pathsOffset;
+};
+
+void testBinaryResults()
+{
+	std::string data = writeResults("binary");
+	uint64_t n = resultFiles.size();
+	uint64_t pairs = n * (n - 1) / 2;
+	MatrixHeader header;
+	if (data.size() < sizeof(header))
+	{
+		check("binary results", false);
+		return;
+	}
+	std::memcpy(&header, data.data(), sizeof(header));
+	bool passed = std::memcmp(header.magic, "CSSM", 4) == 0 && header.version == 1 && header.fileCount == n
+		&& header.matrixOffset >= sizeof(header) && header.matrixOffset % 64 == 0
+		&& header.pathsOffset == header.matrixOffset + pairs * sizeof(float) && header.pathsOffset <= data.size();
+
+	// the upper triangle row by row, 0 for the pair that wasn't written
+	for (uint64_t i = 0; passed && i < n; i++)
+	{
+		for (uint64_t j = i + 1; j < n; j++)
+		{
+			float similarity;
+			std::memcpy(&similarity, data.data() + header.matrixOffset + (i * (2 * n - i - 1) / 2 + j - i - 1) * sizeof(float),
+						sizeof(float));
+			passed = passed && similarity == (i == 1 && j == 2 ? 0 : pairSimilarity(i, j));
+		}
+	}
+
+	size_t position = passed ? header.pathsOffset : data.size();
+	for (size_t file = 0; passed && file < n; file++)
+	{
+		uint32_t length;
+		passed = position + sizeof(length) <= data.size();
+		if (!passed)
+			break;
+		std::memcpy(&length, data.data() + position, sizeof(length));
+		position += sizeof(length);
+		passed = data.compare(position, length, resultFiles[file]) == 0;
+		position += length;
+	}
+	check("binary results", passed && position == data.size());
+}
+
+void testResultWriters()
+{
+	testCsvResults();
+	testJsonLinesResults();
+	testSparseResults();
+	testBinaryResults();
+	check("binary results to stdout", !ResultWriter::create("binary", "-", resultFiles));
+	check("unknown result format", !ResultWriter::create("xml", scratchPath("results.xml"), resultFiles));
+}
+
+//------------------------------------------------------------------------------
+// CorpusIndex
+//------------------------------------------------------------------------------
+
+// The trees of the capted test cases, written to one index and mapped back:
+// the distance of the views of each pair has to be that of the trees, and
+// their profiles have to give the same bounds. The index is rejected when it
+// is cut short, in the labels at its end or in the middle of the arenas.
+void testCorpusIndex(const std::string &testCases)
+{
+	std::ifstream in(testCases);
+	nlohmann::json cases;
+	in >> cases;
+
+	std::vector<std::string> files;
+	std::vector<Node<StringNodeData> *> trees;
+	for (const nlohmann::json &test : cases)
+	{
+		for (const char *tree : {"t1", "t2"})
+		{
+			BracketStringInputParser parser(test[tree].get<std::string>());
+			files.push_back(std::to_string(test["testID"].get<int>()) + tree);
+			trees.push_back(parser.getRoot());
+		}
+	}
+
+	std::string path = scratchPath("corpus.idx");
+	bool written = !trees.empty() && CorpusIndex::write(path, files, trees);
+	check("corpus index write", written && CorpusIndex::isIndexFile(path));
+	if (!written)
+		return;
+
+	BasicStringCostModel<Integer> costModel;
+	LabelDictionary<StringNodeData> labels, treeLabels;
+	CorpusIndex index(path, labels);
+	bool paths = index.size() == files.size();
+	for (size_t file = 0; paths && file < files.size(); file++)
+		paths = index.getPath(file) == files[file];
+	check("corpus index paths", paths);
+
+	for (size_t pair = 0; paths && pair < trees.size() / 2; pair++)
+	{
+		Node<StringNodeData> *t1 = trees[2 * pair], *t2 = trees[2 * pair + 1];
+		Apted<StringNodeData, Integer, Integer> algorithm(&costModel);
+		Integer treeDistance = algorithm.computeEditDistance(t1, t2);
+
+		std::unique_ptr<CorpusIndex::Indexer> view1(index.getIndexer(2 * pair));
+		std::unique_ptr<CorpusIndex::Indexer> view2(index.getIndexer(2 * pair + 1));
+		Integer viewDistance = algorithm.computeEditDistance(view1.get(), view2.get());
+
+		TreeProfile<StringNodeData> profile1 = index.getProfile(2 * pair), profile2 = index.getProfile(2 * pair + 1);
+		TreeProfile<StringNodeData> treeProfile1(t1, treeLabels), treeProfile2(t2, treeLabels);
+		bool profiles = profile1.size == treeProfile1.size && profile2.size == treeProfile2.size
+			&& labelBagLowerBound(profile1, profile2) == labelBagLowerBound(treeProfile1, treeProfile2)
+			&& traversalLowerBound(profile1, profile2, treeDistance) == traversalLowerBound(treeProfile1, treeProfile2, treeDistance);
+		check("corpus index " + files[2 * pair].substr(0, files[2 * pair].size() - 2), viewDistance == treeDistance && profiles);
+	}
+
+	std::string data = readFile(path);
+	for (size_t length : {data.size() - 1, data.size() / 2})
+	{
+		std::string truncated = scratchPath("truncated.idx");
+		std::ofstream(truncated, std::ios::binary).write(data.data(), length);
+		check("truncated corpus index " + std::to_string(length) + " of " + std::to_string(data.size()), exitsWithFailure([&]() {
+			LabelDictionary<StringNodeData> truncatedLabels;
+			CorpusIndex rejected(truncated, truncatedLabels);
+		}));
+	}
+
+	for (Node<StringNodeData> *tree : trees)
+		delete tree;
+}
+
+//------------------------------------------------------------------------------
+// Archive
+//------------------------------------------------------------------------------
+
+const size_t TAR_BLOCK = 512;
+
+// a ustar header block; the size is octal, or base-256 if it says so
+std::string tarHeader(const std::string &name, uint64_t size, char type, bool base256 = false)
+{
+	std::string header(TAR_BLOCK, '\0');
+	header.replace(0, std::min<size_t>(name.size(), 100), name, 0, 100);
+	header.replace(100, 8, "0000644", 8);
+	if (base256)
+	{
+		header[124] = static_cast<char>(0x80);
+		for (size_t i = 0; i < 11; i++)
+			header[135 - i] = static_cast<char>(size >> 8 * i & 0xff);
+	} else
+	{
+		char octal[12];
+		snprintf(octal, sizeof(octal), "%011llo", (unsigned long long)size);
+		header.replace(124, 12, octal, 12);
+	}
+	header[156] = type;
+	header.replace(257, 6, "ustar", 6);
+	header.replace(263, 2, "00");
+
+	// the reader ignores it, but other tools check it
+	header.replace(148, 8, 8, ' ');
+	unsigned sum = 0;
+	for (unsigned char c : header)
+		sum += c;
+	char checksum[8];
+	snprintf(checksum, sizeof(checksum), "%06o", sum);
+	header.replace(148, 7, checksum, 7);
+	return header;
+}
+
+// a header and its contents, padded to whole blocks
+std::string tarMember(const std::string &header, const std::string &contents)
+{
+	return header + contents + std::string((TAR_BLOCK - contents.size() % TAR_BLOCK) % TAR_BLOCK, '\0');
+}
+
+std::string tarEnd()
+{
+	return std::string(2 * TAR_BLOCK, '\0');
+}
+
+// a pax record, "length key=value\n", whose length counts itself
+std::string paxRecord(const std::string &key, const std::string &value)
+{
+	std::string body = " " + key + "=" + value + "\n";
+	size_t length = body.size() + 1;
+	while (std::to_string(length).size() + body.size() != length)
+		length++;
+	return std::to_string(length) + body;
+}
+
+void putLittleEndian(std::string &data, uint32_t value, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; i++)
+		data += static_cast<char>(value >> 8 * i & 0xff);
+}
+
+// A zip archive of stored members, followed by comment. The central directory
+// claims sizeSlack more bytes for every member than there are. CRCs are 0, as
+// the reader doesn't check them.
+std::string zipArchive(const std::vector<ArchiveMember> &members, const std::string &comment, uint32_t sizeSlack = 0)
+{
+	std::string data, directory;
+	for (const ArchiveMember &member : members)
+	{
+		uint32_t local = data.size();
+		data += "PK\x03\x04";
+		putLittleEndian(data, 10, 2);
+		putLittleEndian(data, 0, 2 + 2 + 2 + 2 + 4);
+		putLittleEndian(data, member.contents.size(), 4);
+		putLittleEndian(data, member.contents.size(), 4);
+		putLittleEndian(data, member.path.size(), 2);
+		putLittleEndian(data, 0, 2);
+		data += member.path + member.contents;
+
+		directory += "PK\x01\x02";
+		putLittleEndian(directory, 10, 2);
+		putLittleEndian(directory, 10, 2);
+		putLittleEndian(directory, 0, 2 + 2 + 2 + 2 + 4);
+		putLittleEndian(directory, member.contents.size() + sizeSlack, 4);
+		putLittleEndian(directory, member.contents.size() + sizeSlack, 4);
+		putLittleEndian(directory, member.path.size(), 2);
+		putLittleEndian(directory, 0, 2 + 2 + 2 + 2 + 4);
+		putLittleEndian(directory, local, 4);
+		directory += member.path;
+	}
+
+	uint32_t directoryOffset = data.size();
+	data += directory + "PK\x05\x06";
+	putLittleEndian(data, 0, 2 + 2);
+	putLittleEndian(data, members.size(), 2);
+	putLittleEndian(data, members.size(), 2);
+	putLittleEndian(data, directory.size(), 4);
+	putLittleEndian(data, directoryOffset, 4);
+	putLittleEndian(data, comment.size(), 2);
+	return data + comment;
+}
+
+std::string writeArchive(const std::string &name, const std::string &data)
+{
+	std::string path = scratchPath(name);
+	std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+	return path;
+}
+
+bool sameMembers(const std::vector<ArchiveMember> &members, const std::vector<ArchiveMember> &expected)
+{
+	if (members.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		if (members[i].path != expected[i].path || members[i].contents != expected[i].contents)
+			return false;
+	}
+	return true;
+}
+
+void testTarArchives()
+{
+	// names of more than 100 bytes, which ustar headers can't hold
+	std::string paxName = std::string(120, 'p') + "/pax.c";
+	std::string gnuName = std::string(120, 'g') + "/gnu.c";
+	std::string large(70000, 'x');
+	std::string tar = tarMember(tarHeader("PaxHeaders/pax.c", paxRecord("mtime", "0").size() + paxRecord("path", paxName).size(), 'x'),
+								paxRecord("mtime", "0") + paxRecord("path", paxName))
+		+ tarMember(tarHeader("pax.c", 5, '0'), "int a")
+		+ tarMember(tarHeader("././@LongLink", gnuName.size() + 1, 'L'), gnuName + '\0')
+		+ tarMember(tarHeader("gnu.c", 5, '0'), "int b")
+		+ tarMember(tarHeader("dir/", 0, '5'), "")
+		+ tarMember(tarHeader("large.c", large.size(), '0', true), large)
+		+ tarMember(tarHeader("plain.c", 0, '\0'), "")
+		+ tarEnd();
+	std::string path = writeArchive("corpus.tar", tar);
+	check("tar is an archive", isArchive(path));
+	check("tar members", sameMembers(readArchive(path), {
+		{paxName, "int a"}, {gnuName, "int b"}, {"large.c", large}, {"plain.c", ""},
+	}));
+
+	// the contents end before the size in the header
+	std::string truncated = writeArchive("truncated.tar", tarMember(tarHeader("a.c", 2 * TAR_BLOCK, '0'), "int a"));
+	check("truncated tar member", exitsWithFailure([&]() { readArchive(truncated); }));
+}
+
+void testZipArchives()
+{
+	std::vector<ArchiveMember> members = {{"a.c", "int a;"}, {"dir/", ""}, {"dir/b.c", "int b;"}};
+	std::vector<ArchiveMember> files = {members[0], members[2]};
+	std::string path = writeArchive("corpus.zip", zipArchive(members, ""));
+	check("zip is an archive", isArchive(path));
+	check("zip members", sameMembers(readArchive(path), files));
+
+	// the end of the central directory is searched for before the comment
+	std::string commented = writeArchive("commented.zip", zipArchive(members, std::string(1000, 'c')));
+	check("zip with a comment", sameMembers(readArchive(commented), files));
+
+	std::string truncated = writeArchive("truncated.zip", zipArchive(members, "", 1000));
+	check("truncated zip member", exitsWithFailure([&]() { readArchive(truncated); }));
+	std::string zip = zipArchive(members, "");
+	std::string cut = writeArchive("cut.zip", zip.substr(0, zip.size() - 10));
+	check("zip without an end", exitsWithFailure([&]() { readArchive(cut); }));
+}
+
+void testArchives()
+{
+	testTarArchives();
+	testZipArchives();
+	check("not an archive", !isArchive(scratchPath("missing")));
+}
+
+} // namespace
+
+// usage: codesim_tests path/to/correctness_test_cases.json
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: codesim_tests path/to/correctness_test_cases.json" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	char scratch[] = "/tmp/codesim-tests-XXXXXX";
+	if (!mkdtemp(scratch))
+	{
+		std::cerr << "Can't make a scratch directory" << std::endl;
+		return EXIT_FAILURE;
+	}
+	scratchDir = scratch;
+
+	testResultWriters();
+	testCorpusIndex(argv[1]);
+	testArchives();
+
+	for (const std::string &path : scratchFiles)
+		std::remove(path.c_str());
+	rmdir(scratch);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}